@@ -0,0 +1,131 @@
+// Arduino.h (host shim)
+//
+// Minimal stand-in for the Arduino-ESP32 core so the project libraries can be
+// compiled, benchmarked and tested on the host by the native environments.
+// Time is virtual and only moves when the caller sets it; hardware calls are
+// counted (and gate changes logged) instead of performed.
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+using std::max;
+using std::min;
+
+#define IRAM_ATTR
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+#define INPUT 0x01
+#define INPUT_PULLUP 0x05
+#define OUTPUT 0x03
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+#define digitalPinToInterrupt(p) (p)
+
+// --- Time ---
+unsigned long micros();
+unsigned long millis();
+
+// --- GPIO / LEDC ---
+void pinMode(uint8_t pin, uint8_t mode);
+void attachInterruptArg(uint8_t pin, void (*isr)(void *), void *arg, int mode);
+void detachInterrupt(uint8_t pin);
+double ledcSetup(uint8_t channel, double freq, uint8_t resolution_bits);
+void ledcAttachPin(uint8_t pin, uint8_t channel);
+void ledcWrite(uint8_t channel, uint32_t duty);
+
+// --- esp_timer ---
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+
+typedef void (*esp_timer_cb_t)(void *arg);
+
+typedef struct
+{
+    esp_timer_cb_t callback;
+    void *arg;
+    const char *name;
+} esp_timer_create_args_t;
+
+struct esp_timer
+{
+    esp_timer_cb_t callback;
+    void *arg;
+    const char *name;
+    bool armed;
+    uint64_t deadline_us;
+};
+typedef struct esp_timer *esp_timer_handle_t;
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out_handle);
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us);
+esp_err_t esp_timer_stop(esp_timer_handle_t timer);
+esp_err_t esp_timer_delete(esp_timer_handle_t timer);
+
+// --- Serial ---
+class HostSerial
+{
+public:
+    void begin(unsigned long) {}
+    int printf(const char *format, ...);
+    void println(const char *s) { ::printf("%s\n", s); }
+};
+extern HostSerial Serial;
+
+// --- Host control, used by the benchmark and the native tests only ---
+namespace host
+{
+    struct Counters
+    {
+        unsigned long timerStarts;
+        unsigned long timerStops;
+        unsigned long ledcWrites;
+        unsigned long gateOn;         // ledcWrite() calls that start a pulse train
+        unsigned long timerCallbacks; // Callbacks run by runTimersUntil()
+    };
+
+    // A change of the TRIAC gate output (LEDC duty going from 0 to on or back).
+    struct GateEdge
+    {
+        unsigned long time_us;
+        bool on;
+    };
+
+    void setMicros(unsigned long now_us);
+    Counters &counters();
+    void resetCounters();
+
+    // Gate changes since the last clearGateLog(). If the gate is on when the log
+    // is cleared, the log starts with an "on" edge at that time.
+    const std::vector<GateEdge> &gateLog();
+    void clearGateLog();
+
+    // Offset into [from_us, to_us) of the first moment the gate is on, according
+    // to the gate log, or -1 if it is off throughout.
+    long firstGateOn(unsigned long from_us, unsigned long to_us);
+
+    // The ISR registered with attachInterruptArg() and its argument.
+    void (*zeroCrossIsr())(void *);
+    void *zeroCrossArg();
+
+    // Looks up a timer created with esp_timer_create() by its name.
+    esp_timer_handle_t findTimer(const char *name);
+
+    // Disarms every timer without running it, as if they had all expired.
+    void disarmAllTimers();
+
+    // Runs every armed timer due at or before until_us in deadline order,
+    // moving virtual time to each deadline. Time ends at until_us.
+    void runTimersUntil(unsigned long until_us);
+}
+
+#endif // HOST_ARDUINO_H
@@ -0,0 +1,172 @@
+// HostShim.cpp
+
+#include "Arduino.h"
+
+HostSerial Serial;
+
+namespace
+{
+    unsigned long g_now_us = 0;
+    host::Counters g_counters = {};
+    void (*g_zcIsr)(void *) = nullptr;
+    void *g_zcArg = nullptr;
+    std::vector<esp_timer *> g_timers;
+    bool g_gateOn = false;
+    std::vector<host::GateEdge> g_gateLog;
+}
+
+// --- Time ---
+unsigned long micros() { return g_now_us; }
+unsigned long millis() { return g_now_us / 1000; }
+
+// --- GPIO / LEDC ---
+void pinMode(uint8_t, uint8_t) {}
+
+void attachInterruptArg(uint8_t, void (*isr)(void *), void *arg, int)
+{
+    g_zcIsr = isr;
+    g_zcArg = arg;
+}
+
+void detachInterrupt(uint8_t)
+{
+    g_zcIsr = nullptr;
+    g_zcArg = nullptr;
+}
+
+double ledcSetup(uint8_t, double freq, uint8_t) { return freq; }
+void ledcAttachPin(uint8_t, uint8_t) {}
+void ledcWrite(uint8_t, uint32_t duty)
+{
+    g_counters.ledcWrites++;
+    if (duty > 0)
+        g_counters.gateOn++;
+    if ((duty > 0) != g_gateOn)
+    {
+        g_gateOn = (duty > 0);
+        g_gateLog.push_back({g_now_us, g_gateOn});
+    }
+}
+
+// --- esp_timer ---
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out_handle)
+{
+    esp_timer *timer = new esp_timer{args->callback, args->arg, args->name, false, 0};
+    g_timers.push_back(timer);
+    *out_handle = timer;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    if (timer->armed)
+        return ESP_FAIL; // Same as ESP-IDF: a running timer cannot be restarted
+    timer->armed = true;
+    timer->deadline_us = g_now_us + timeout_us;
+    g_counters.timerStarts++;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    if (!timer->armed)
+        return ESP_FAIL;
+    timer->armed = false;
+    g_counters.timerStops++;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_delete(esp_timer_handle_t timer)
+{
+    for (size_t i = 0; i < g_timers.size(); ++i)
+    {
+        if (g_timers[i] == timer)
+        {
+            g_timers.erase(g_timers.begin() + i);
+            break;
+        }
+    }
+    delete timer;
+    return ESP_OK;
+}
+
+// --- Serial ---
+int HostSerial::printf(const char *format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int n = vprintf(format, args);
+    va_end(args);
+    return n;
+}
+
+// --- Host control ---
+namespace host
+{
+    void setMicros(unsigned long now_us) { g_now_us = now_us; }
+    Counters &counters() { return g_counters; }
+    void resetCounters() { g_counters = {}; }
+
+    const std::vector<GateEdge> &gateLog() { return g_gateLog; }
+
+    void clearGateLog()
+    {
+        g_gateLog.clear();
+        if (g_gateOn)
+            g_gateLog.push_back({g_now_us, true});
+    }
+
+    long firstGateOn(unsigned long from_us, unsigned long to_us)
+    {
+        for (size_t i = 0; i < g_gateLog.size(); ++i)
+        {
+            if (!g_gateLog[i].on)
+                continue;
+            bool closed = (i + 1 < g_gateLog.size());
+            if (g_gateLog[i].time_us < to_us && (!closed || g_gateLog[i + 1].time_us > from_us))
+                return (g_gateLog[i].time_us > from_us) ? (long)(g_gateLog[i].time_us - from_us) : 0;
+        }
+        return -1;
+    }
+
+    void (*zeroCrossIsr())(void *) { return g_zcIsr; }
+    void *zeroCrossArg() { return g_zcArg; }
+
+    esp_timer_handle_t findTimer(const char *name)
+    {
+        for (esp_timer *timer : g_timers)
+        {
+            if (strcmp(timer->name, name) == 0)
+                return timer;
+        }
+        return nullptr;
+    }
+
+    void disarmAllTimers()
+    {
+        for (esp_timer *timer : g_timers)
+            timer->armed = false;
+    }
+
+    void runTimersUntil(unsigned long until_us)
+    {
+        for (;;)
+        {
+            esp_timer *next = nullptr;
+            for (esp_timer *timer : g_timers)
+            {
+                if (timer->armed && timer->deadline_us <= until_us &&
+                    (next == nullptr || timer->deadline_us < next->deadline_us))
+                    next = timer;
+            }
+            if (next == nullptr)
+                break;
+
+            g_now_us = next->deadline_us;
+            next->armed = false;
+            g_counters.timerCallbacks++;
+            next->callback(next->arg);
+        }
+        g_now_us = until_us;
+    }
+}
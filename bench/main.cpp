@@ -0,0 +1,702 @@
+// Host benchmark for the ISR and control hot paths.
+//
+// Build and run with the native environment:
+//   pio run -e native_bench
+//   .pio/build/native_bench/program [options]
+//
+// Options:
+//   --iterations N     Measured operations per case and repetition (default 20000).
+//   --repeats N        Runs of the whole suite (default 5); each case reports its median.
+//   --batch N          Operations timed together for ns_per_op (default 64).
+//   --periods FILE     Adds a recorded period stream: one period in microseconds per
+//                      line, '#' comments. Its cases are named after the file.
+//   --filter TEXT      Only runs cases whose id contains TEXT.
+//   --out FILE         Also writes the results to FILE.
+//   --baseline FILE    Compares against a previous run and flags regressions.
+//   --threshold R      Allowed slowdown ratio before a case is a regression (default 0.15).
+//   --noise-floor NS   Slowdowns smaller than this many ns are never regressions (default 10).
+//
+// Every case prints one JSON object per line. ns_per_op comes from timing batches
+// of operations, since one clock read costs about as much as the cheaper ops; the
+// latency percentiles time single operations. Both are the median over the
+// repetitions, and ns_per_op_min is the fastest repetition.
+// In comparison mode a {"regression":...} line is printed for every case whose
+// ns_per_op got slower than the baseline by more than both the threshold and the
+// noise floor, and the exit code is 1 if there was any. The percentiles are only
+// reported: single-op timings on a host move with interrupts and clock scaling far
+// more than with any code change. A baseline taken with other --iterations or
+// --repeats is refused (exit code 2): the numbers would not be comparable.
+// On a shared or virtual machine, compare an unchanged build against its own
+// baseline a few times and raise --threshold until that reports nothing.
+//
+// Only timing is measured here. Correctness checks (Mailbox handoff, firing
+// modes) are unit tests under test/, run with: pio test -e native_test
+
+#include <Arduino.h>
+#include "ACFrequencyMonitor.h"
+#include "TriacController.h"
+#include "WeldRegulator.h"
+#include "Mailbox.h"
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    struct Options
+    {
+        unsigned long iterations = 20000;
+        unsigned long repeats = 5;
+        unsigned long batch = 64;
+        std::string periodsFile;
+        std::string filter;
+        std::string outFile;
+        std::string baselineFile;
+        double threshold = 0.15;
+        double noiseFloor_ns = 10.0;
+    };
+
+    struct Stream
+    {
+        std::string name;
+        std::vector<unsigned long> periods_us;
+    };
+
+    struct Result
+    {
+        std::string id;
+        unsigned long iterations;
+        unsigned long repeats;
+        double ns_per_op;
+        double ns_per_op_min;
+        double p50_ns;
+        double p90_ns;
+        double p99_ns;
+        double p999_ns;
+        double max_ns;
+    };
+
+    typedef std::chrono::steady_clock Clock;
+
+    const uint8_t FILTER_SIZES[] = {3, 5, 7, 9, 15};
+    const float POWER_LEVELS[] = {0.0, 25.0, 50.0, 75.0, 100.0};
+    const size_t STREAM_LENGTH = 4096;
+
+    // Per-repetition figures of one case, reduced by summarize().
+    struct Repetitions
+    {
+        std::vector<double> ns_per_op;
+        std::vector<double> p50_ns;
+        std::vector<double> p90_ns;
+        std::vector<double> p99_ns;
+        std::vector<double> p999_ns;
+        double max_ns = 0.0;
+    };
+
+    Options g_options;
+    std::map<std::string, Repetitions> g_repetitions;
+    std::vector<std::string> g_caseOrder;
+    std::vector<Result> g_results;
+    double g_clockOverhead_ns = 0.0;
+
+    // --- Period streams ---
+    std::vector<Stream> makeStreams()
+    {
+        std::vector<Stream> streams;
+        std::mt19937 rng(12345); // Fixed seed so every run sees the same streams
+        std::normal_distribution<double> jitter(0.0, 40.0);
+
+        Stream clean{"clean", {}};
+        Stream noisy{"jitter", {}};
+        Stream spikes{"spikes", {}};
+        Stream drift{"drift", {}};
+        Stream noiseEdges{"noise_edges", {}};
+        Stream missedEdges{"missed_edges", {}};
+        for (size_t i = 0; i < STREAM_LENGTH; ++i)
+        {
+            double noise = jitter(rng);
+            unsigned long period = (unsigned long)(20000 + noise);
+            clean.periods_us.push_back(20000);
+            noisy.periods_us.push_back(period);
+            // Every 37th edge is a noise-induced early zero-cross (out of range)
+            spikes.periods_us.push_back((i % 37 == 36) ? 3000 : period);
+            // Slow sweep between 49.5Hz and 50.5Hz
+            double freq = 50.0 + 0.5 * sin(2.0 * M_PI * i / STREAM_LENGTH);
+            drift.periods_us.push_back((unsigned long)(1000000.0 / freq + noise));
+            // A spurious edge splits a period in two: the short part, then the rest
+            if (i % 53 == 52)
+            {
+                unsigned long early = 1000 + rng() % 8000;
+                noiseEdges.periods_us.push_back(early);
+                noiseEdges.periods_us.push_back(period - early);
+            }
+            else
+            {
+                noiseEdges.periods_us.push_back(period);
+            }
+            // A missed edge merges two periods into one
+            missedEdges.periods_us.push_back((i % 61 == 60) ? period + (unsigned long)(20000 + jitter(rng)) : period);
+        }
+        streams.push_back(clean);
+        streams.push_back(noisy);
+        streams.push_back(spikes);
+        streams.push_back(drift);
+        streams.push_back(noiseEdges);
+        streams.push_back(missedEdges);
+
+        if (g_options.periodsFile.empty())
+            return streams;
+
+        // A recorded stream is named after its file, e.g. "capture" for capture.txt.
+        std::string name = g_options.periodsFile;
+        size_t slash = name.find_last_of('/');
+        if (slash != std::string::npos)
+            name = name.substr(slash + 1);
+        name = name.substr(0, name.find('.'));
+
+        Stream fromFile{name, {}};
+        std::ifstream in(g_options.periodsFile);
+        std::string line;
+        while (std::getline(in, line))
+        {
+            if (line.empty() || line[0] == '#')
+                continue;
+            unsigned long period = strtoul(line.c_str(), nullptr, 10);
+            if (period > 0)
+                fromFile.periods_us.push_back(period);
+        }
+        if (fromFile.periods_us.empty())
+            fprintf(stderr, "No periods read from %s; file stream skipped\n", g_options.periodsFile.c_str());
+        else
+            streams.push_back(fromFile);
+        return streams;
+    }
+
+    // --- Measurement ---
+    double nanosBetween(Clock::time_point a, Clock::time_point b)
+    {
+        return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(b - a).count();
+    }
+
+    void calibrateClock()
+    {
+        std::vector<double> samples(100000);
+        for (double &s : samples)
+        {
+            Clock::time_point t0 = Clock::now();
+            Clock::time_point t1 = Clock::now();
+            s = nanosBetween(t0, t1);
+        }
+        std::sort(samples.begin(), samples.end());
+        g_clockOverhead_ns = samples[samples.size() / 2];
+    }
+
+    bool selected(const std::string &id)
+    {
+        return g_options.filter.empty() || id.find(g_options.filter) != std::string::npos;
+    }
+
+    double percentile(const std::vector<double> &sorted, double p)
+    {
+        size_t index = (size_t)(p * (sorted.size() - 1) + 0.5);
+        return sorted[index];
+    }
+
+    double median(std::vector<double> values)
+    {
+        std::sort(values.begin(), values.end());
+        return percentile(values, 0.5);
+    }
+
+    // Runs one repetition of a case: op(i) for every iteration, with setup(i)
+    // before each op to put the device model in the state the op expects.
+    //
+    // The latency pass times single ops, with setup(i) outside the timed region.
+    // The throughput pass times batches of setup+op and takes out the cost of
+    // setup() measured on its own.
+    template <typename Setup, typename Op>
+    void runCase(const std::string &id, Setup setup, Op op)
+    {
+        if (!selected(id))
+            return;
+
+        const unsigned long n = g_options.iterations;
+        const unsigned long batch = std::min(g_options.batch, n);
+        const unsigned long batches = n / batch;
+        const unsigned long warmup = n / 10 + 1;
+        unsigned long i = 0;
+
+        // The setup-only batches disturb the model (the clock jumps ahead with no
+        // op in between), so they run first and the warm-up settles it again.
+        double setup_ns = 1e300;
+        for (unsigned long b = 0; b < 16; ++b)
+        {
+            Clock::time_point t0 = Clock::now();
+            for (unsigned long k = 0; k < batch; ++k)
+                setup(i++);
+            Clock::time_point t1 = Clock::now();
+            setup_ns = std::min(setup_ns, (nanosBetween(t0, t1) - g_clockOverhead_ns) / batch);
+        }
+        setup_ns = std::max(0.0, setup_ns);
+
+        for (unsigned long k = 0; k < warmup; ++k, ++i)
+        {
+            setup(i);
+            op(i);
+        }
+
+        std::vector<double> samples;
+        samples.reserve(n);
+        for (unsigned long k = 0; k < n; ++k, ++i)
+        {
+            setup(i);
+            Clock::time_point t0 = Clock::now();
+            op(i);
+            Clock::time_point t1 = Clock::now();
+            samples.push_back(std::max(0.0, nanosBetween(t0, t1) - g_clockOverhead_ns));
+        }
+        std::sort(samples.begin(), samples.end());
+
+        double total_ns = 0.0;
+        for (unsigned long b = 0; b < batches; ++b)
+        {
+            Clock::time_point t0 = Clock::now();
+            for (unsigned long k = 0; k < batch; ++k, ++i)
+            {
+                setup(i);
+                op(i);
+            }
+            Clock::time_point t1 = Clock::now();
+            total_ns += nanosBetween(t0, t1) - g_clockOverhead_ns;
+        }
+
+        auto it = g_repetitions.find(id);
+        if (it == g_repetitions.end())
+        {
+            g_caseOrder.push_back(id);
+            it = g_repetitions.insert({id, Repetitions()}).first;
+        }
+        Repetitions &reps = it->second;
+        reps.ns_per_op.push_back(std::max(0.0, total_ns / (batches * batch) - setup_ns));
+        reps.p50_ns.push_back(percentile(samples, 0.50));
+        reps.p90_ns.push_back(percentile(samples, 0.90));
+        reps.p99_ns.push_back(percentile(samples, 0.99));
+        reps.p999_ns.push_back(percentile(samples, 0.999));
+        reps.max_ns = std::max(reps.max_ns, samples.back());
+    }
+
+    // Reduces the repetitions of every case to its result: the median of each
+    // figure, the fastest repetition, and the overall maximum.
+    void summarize()
+    {
+        for (const std::string &id : g_caseOrder)
+        {
+            const Repetitions &reps = g_repetitions[id];
+            Result r;
+            r.id = id;
+            r.iterations = g_options.iterations;
+            r.repeats = reps.ns_per_op.size();
+            r.ns_per_op = median(reps.ns_per_op);
+            r.ns_per_op_min = *std::min_element(reps.ns_per_op.begin(), reps.ns_per_op.end());
+            r.p50_ns = median(reps.p50_ns);
+            r.p90_ns = median(reps.p90_ns);
+            r.p99_ns = median(reps.p99_ns);
+            r.p999_ns = median(reps.p999_ns);
+            r.max_ns = reps.max_ns;
+            g_results.push_back(r);
+        }
+    }
+
+    std::string formatResult(const Result &r)
+    {
+        char line[512];
+        snprintf(line, sizeof(line),
+                 "{\"id\":\"%s\",\"iterations\":%lu,\"repeats\":%lu,\"ns_per_op\":%.2f,"
+                 "\"ns_per_op_min\":%.2f,\"p50_ns\":%.1f,\"p90_ns\":%.1f,\"p99_ns\":%.1f,"
+                 "\"p999_ns\":%.1f,\"max_ns\":%.1f}",
+                 r.id.c_str(), r.iterations, r.repeats, r.ns_per_op, r.ns_per_op_min,
+                 r.p50_ns, r.p90_ns, r.p99_ns, r.p999_ns, r.max_ns);
+        return line;
+    }
+
+    // --- Cases ---
+    void benchFrequencyMonitor(const std::vector<Stream> &streams)
+    {
+        for (const Stream &stream : streams)
+        {
+            for (uint8_t filterSize : FILTER_SIZES)
+            {
+                ACFrequencyMonitor monitor;
+                monitor.begin(filterSize);
+                monitor.setLowPassFilterAlpha(0.99);
+                const std::vector<unsigned long> &periods = stream.periods_us;
+
+                std::string id = "freq_add_sample/stream=" + stream.name +
+                                 "/filter=" + std::to_string(filterSize);
+                runCase(
+                    id, [](unsigned long) {},
+                    [&](unsigned long i)
+                    { monitor.addNewPeriodSample(periods[i % periods.size()]); });
+            }
+        }
+    }
+
+    void benchTriacZeroCross(const std::vector<Stream> &streams)
+    {
+        for (const Stream &stream : streams)
+        {
+            for (uint8_t filterSize : FILTER_SIZES)
+            {
+                for (float power : POWER_LEVELS)
+                {
+                    TriacController triac;
+                    triac.begin(14, 48, 45.0, 65.0, filterSize);
+                    triac.setMeasurementDelay(3000);
+                    triac.setLowPassFilterAlpha(0.99);
+                    triac.setPower(power);
+
+                    void (*isr)(void *) = host::zeroCrossIsr();
+                    void *arg = host::zeroCrossArg();
+                    esp_timer_handle_t tick = host::findTimer("zero_cross_timer");
+                    const std::vector<unsigned long> &periods = stream.periods_us;
+                    unsigned long now_us = 1000000;
+
+                    char id[128];
+                    snprintf(id, sizeof(id), "triac_zero_cross/stream=%s/filter=%u/power=%.0f",
+                             stream.name.c_str(), filterSize, power);
+                    runCase(
+                        id,
+                        [&](unsigned long i)
+                        {
+                            host::disarmAllTimers();
+                            now_us += periods[i % periods.size()];
+                            host::setMicros(now_us);
+                        },
+                        [&](unsigned long)
+                        {
+                            // The GPIO ISR plus the work it defers to the esp_timer task
+                            isr(arg);
+                            tick->armed = false;
+                            tick->callback(tick->arg);
+                        });
+                }
+            }
+        }
+    }
+
+    void benchTriacHalfCycle()
+    {
+        for (float power : POWER_LEVELS)
+        {
+            TriacController triac;
+            triac.begin(14, 48);
+            triac.setMeasurementDelay(3000);
+            triac.setPower(power);
+
+            // Lock the frequency monitor onto a clean 50Hz signal first.
+            void (*isr)(void *) = host::zeroCrossIsr();
+            void *arg = host::zeroCrossArg();
+            unsigned long now_us = 1000000;
+            for (int i = 0; i < 32; ++i)
+            {
+                host::disarmAllTimers();
+                now_us += 20000;
+                host::setMicros(now_us);
+                isr(arg);
+                host::runTimersUntil(now_us);
+            }
+
+            esp_timer_handle_t halfCycle = host::findTimer("half_cycle_timer");
+            char id[64];
+            snprintf(id, sizeof(id), "triac_half_cycle/power=%.0f", power);
+            runCase(
+                id,
+                [&](unsigned long)
+                {
+                    host::disarmAllTimers();
+                    now_us += 10000;
+                    host::setMicros(now_us);
+                },
+                [&](unsigned long)
+                { halfCycle->callback(halfCycle->arg); });
+        }
+    }
+
+    void benchMapPowerToAngle()
+    {
+        TriacController triac;
+        triac.begin(14, 48);
+        for (float power : POWER_LEVELS)
+        {
+            // _mapPowerToAngle() is private; setPower() is its only caller.
+            char id[64];
+            snprintf(id, sizeof(id), "map_power_to_angle/power=%.0f", power);
+            runCase(
+                id, [](unsigned long) {},
+                [&](unsigned long i)
+                { triac.setPower(power + (i & 1) * 0.5f); });
+        }
+    }
+
+    void benchControlStep()
+    {
+        static const struct
+        {
+            const char *name;
+            RegulationMode mode;
+            float setpoint;
+        } modes[] = {
+            {"voltage", RegulationMode::VOLTAGE, 120.0},
+            {"current", RegulationMode::CURRENT, 8.0},
+            {"power", RegulationMode::POWER, 900.0},
+        };
+
+        for (const auto &m : modes)
+        {
+            TriacController triac;
+            triac.begin(14, 48);
+            WeldRegulator regulator;
+            regulator.begin(&triac, 50);
+            regulator.setMode(m.mode);
+            regulator.setSetpoint(m.setpoint);
+
+            // A crude resistive plant so the PID sees a moving input.
+            unsigned long now_us = 1000000;
+            std::string id = std::string("control_step/mode=") + m.name;
+            runCase(
+                id,
+                [&](unsigned long)
+                {
+                    now_us += 50000; // One PID sample time per step
+                    host::setMicros(now_us);
+                },
+                [&](unsigned long)
+                {
+                    float voltage = 2.3f * triac.getCurrentPower();
+                    regulator.addSample(voltage, voltage / 15.0f, now_us);
+                    regulator.compute();
+                });
+        }
+    }
+
+    // Threaded model of the cross-core handoff: one thread stands in for the
+    // firing core and one for the control core. Only the cost of each side is
+    // measured here; test/test_mailbox checks the values that cross over.
+    struct HandoffPayload
+    {
+        uint32_t sequence;
+        uint32_t words[7];
+    };
+
+    HandoffPayload makePayload(uint32_t sequence)
+    {
+        HandoffPayload p;
+        p.sequence = sequence;
+        for (uint32_t k = 0; k < 7; ++k)
+            p.words[k] = sequence * 2654435761u + k;
+        return p;
+    }
+
+    void benchMailboxHandoff()
+    {
+        // Timed producer, free-running consumer
+        {
+            Mailbox<HandoffPayload> mailbox;
+            std::atomic<bool> done{false};
+
+            std::thread consumer([&]
+                                 {
+                HandoffPayload p = {};
+                while (!done.load(std::memory_order_relaxed))
+                    mailbox.fetch(p); });
+
+            uint32_t sequence = 1;
+            runCase(
+                "mailbox_handoff/side=post", [](unsigned long) {},
+                [&](unsigned long)
+                { mailbox.post(makePayload(sequence++)); });
+            done = true;
+            consumer.join();
+        }
+
+        // Timed consumer, free-running producer
+        {
+            Mailbox<HandoffPayload> mailbox;
+            std::atomic<bool> done{false};
+
+            std::thread producer([&]
+                                 {
+                uint32_t sequence = 1;
+                while (!done.load(std::memory_order_relaxed))
+                    mailbox.post(makePayload(sequence++)); });
+
+            HandoffPayload p = {};
+            runCase(
+                "mailbox_handoff/side=fetch", [](unsigned long) {},
+                [&](unsigned long)
+                { mailbox.fetch(p); });
+            done = true;
+            producer.join();
+        }
+    }
+
+    // --- Baseline comparison ---
+    bool readNumber(const std::string &line, const char *key, double &value)
+    {
+        std::string pattern = std::string("\"") + key + "\":";
+        size_t pos = line.find(pattern);
+        if (pos == std::string::npos)
+            return false;
+        value = atof(line.c_str() + pos + pattern.size());
+        return true;
+    }
+
+    bool readId(const std::string &line, std::string &id)
+    {
+        const std::string pattern = "\"id\":\"";
+        size_t start = line.find(pattern);
+        if (start == std::string::npos)
+            return false;
+        start += pattern.size();
+        size_t end = line.find('"', start);
+        if (end == std::string::npos)
+            return false;
+        id = line.substr(start, end - start);
+        return true;
+    }
+
+    int compareWithBaseline()
+    {
+        std::ifstream in(g_options.baselineFile);
+        if (!in)
+        {
+            fprintf(stderr, "Cannot open baseline %s\n", g_options.baselineFile.c_str());
+            return 2;
+        }
+
+        std::map<std::string, Result> baseline;
+        std::string line;
+        while (std::getline(in, line))
+        {
+            Result r = {};
+            double iterations = 0.0, repeats = 0.0;
+            if (readId(line, r.id) && readNumber(line, "iterations", iterations) &&
+                readNumber(line, "repeats", repeats) && readNumber(line, "ns_per_op", r.ns_per_op))
+            {
+                r.iterations = (unsigned long)iterations;
+                r.repeats = (unsigned long)repeats;
+                baseline[r.id] = r;
+            }
+        }
+
+        for (const Result &current : g_results)
+        {
+            auto it = baseline.find(current.id);
+            if (it != baseline.end() &&
+                (it->second.iterations != current.iterations || it->second.repeats != current.repeats))
+            {
+                fprintf(stderr, "Baseline %s was taken with %lu iterations x %lu repeats, this run with %lu x %lu\n",
+                        g_options.baselineFile.c_str(), it->second.iterations, it->second.repeats,
+                        current.iterations, current.repeats);
+                return 2;
+            }
+        }
+
+        int regressions = 0;
+        for (const Result &current : g_results)
+        {
+            auto it = baseline.find(current.id);
+            if (it == baseline.end())
+                continue;
+
+            double base = it->second.ns_per_op;
+            double now = current.ns_per_op;
+            if (base <= 0.0 || now <= base * (1.0 + g_options.threshold) || now - base <= g_options.noiseFloor_ns)
+                continue;
+            printf("{\"regression\":\"%s\",\"metric\":\"ns_per_op\",\"baseline\":%.2f,\"current\":%.2f,\"ratio\":%.3f}\n",
+                   current.id.c_str(), base, now, now / base);
+            regressions++;
+        }
+
+        fprintf(stderr, "%d regression(s) against %s (threshold +%.0f%%, noise floor %.0fns)\n",
+                regressions, g_options.baselineFile.c_str(), g_options.threshold * 100.0,
+                g_options.noiseFloor_ns);
+        return regressions > 0 ? 1 : 0;
+    }
+
+    bool parseArgs(int argc, char **argv)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            bool hasValue = (i + 1 < argc);
+            if (arg == "--iterations" && hasValue)
+                g_options.iterations = std::max(1ul, strtoul(argv[++i], nullptr, 10));
+            else if (arg == "--repeats" && hasValue)
+                g_options.repeats = std::max(1ul, strtoul(argv[++i], nullptr, 10));
+            else if (arg == "--batch" && hasValue)
+                g_options.batch = std::max(1ul, strtoul(argv[++i], nullptr, 10));
+            else if (arg == "--periods" && hasValue)
+                g_options.periodsFile = argv[++i];
+            else if (arg == "--filter" && hasValue)
+                g_options.filter = argv[++i];
+            else if (arg == "--out" && hasValue)
+                g_options.outFile = argv[++i];
+            else if (arg == "--baseline" && hasValue)
+                g_options.baselineFile = argv[++i];
+            else if (arg == "--threshold" && hasValue)
+                g_options.threshold = atof(argv[++i]);
+            else if (arg == "--noise-floor" && hasValue)
+                g_options.noiseFloor_ns = atof(argv[++i]);
+            else
+            {
+                fprintf(stderr, "Unknown or incomplete option: %s\n", arg.c_str());
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (!parseArgs(argc, argv))
+        return 2;
+
+    calibrateClock();
+    std::vector<Stream> streams = makeStreams();
+
+    // The whole suite runs once per repetition, so a slow spell on the machine
+    // lands in one repetition of many cases instead of every repetition of a few.
+    for (unsigned long rep = 0; rep < g_options.repeats; ++rep)
+    {
+        benchFrequencyMonitor(streams);
+        benchTriacZeroCross(streams);
+        benchTriacHalfCycle();
+        benchMapPowerToAngle();
+        benchControlStep();
+        benchMailboxHandoff();
+    }
+    summarize();
+
+    FILE *out = g_options.outFile.empty() ? nullptr : fopen(g_options.outFile.c_str(), "w");
+    for (const Result &r : g_results)
+    {
+        std::string line = formatResult(r);
+        printf("%s\n", line.c_str());
+        if (out)
+            fprintf(out, "%s\n", line.c_str());
+    }
+    if (out)
+        fclose(out);
+
+    if (!g_options.baselineFile.empty())
+        return compareWithBaseline();
+    return 0;
+}
@@ -0,0 +1,53 @@
+#ifndef EXECUTION_MODEL_H
+#define EXECUTION_MODEL_H
+
+// Core and priority partitioning of the firmware. Every value can be
+// overridden from build_flags in platformio.ini (e.g. -DEXEC_PARTITIONED=0).
+//
+// Partitioned model (EXEC_PARTITIONED=1):
+//   FIRING_CORE  - zero-cross GPIO interrupt and the esp_timer task that runs
+//                  the half-cycle, firing and stop-pulse timers. Nothing else
+//                  from this firmware runs here.
+//   CONTROL_CORE - control task (sensor parsing, regulator) and, below it,
+//                  the comms task (Serial commands and telemetry output).
+// State crosses cores through Mailbox (lock-free, latest value wins); events
+// such as Serial commands go through a FreeRTOS queue so none is lost.
+//
+// Legacy model (EXEC_PARTITIONED=0): everything runs from loop() as before,
+// which is useful to compare the firing jitter of both layouts.
+
+#ifndef EXEC_PARTITIONED
+#define EXEC_PARTITIONED 1
+#endif
+
+// The esp_timer task is pinned to core 0 by the Arduino-ESP32 sdkconfig, so
+// the firing core has to be core 0 for the timers to share it with the ZC ISR.
+#ifndef FIRING_CORE
+#define FIRING_CORE 0
+#endif
+
+#ifndef CONTROL_CORE
+#define CONTROL_CORE 1
+#endif
+
+// Priority the esp_timer task is raised to (the IPC tasks stay above it).
+#ifndef FIRING_TIMER_TASK_PRIORITY
+#define FIRING_TIMER_TASK_PRIORITY (configMAX_PRIORITIES - 2)
+#endif
+
+#ifndef CONTROL_TASK_PRIORITY
+#define CONTROL_TASK_PRIORITY 5
+#endif
+
+#ifndef COMMS_TASK_PRIORITY
+#define COMMS_TASK_PRIORITY 2
+#endif
+
+#ifndef CONTROL_PERIOD_MS
+#define CONTROL_PERIOD_MS 1
+#endif
+
+#define CONTROL_TASK_STACK 4096
+#define COMMS_TASK_STACK 6144
+
+#endif // EXECUTION_MODEL_H
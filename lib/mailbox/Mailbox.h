@@ -0,0 +1,60 @@
+// Mailbox.h
+
+#ifndef MAILBOX_H
+#define MAILBOX_H
+
+#include <stdint.h>
+#include <atomic>
+
+/**
+ * @brief Lock-free single-producer, single-consumer "latest value" mailbox.
+ *
+ * Used to hand data between the firing core and the control core without
+ * disabling interrupts or taking a mutex. It is a triple buffer: the producer
+ * and consumer each own one slot and swap it with the shared middle slot
+ * through a single atomic exchange, so neither side ever waits and a reader
+ * never sees a half-written value. Values posted faster than they are fetched
+ * are overwritten; only the newest one is delivered.
+ *
+ * Exactly one task/ISR may call post() and exactly one may call fetch().
+ */
+template <typename T>
+class Mailbox
+{
+public:
+    /**
+     * @brief Publishes a new value, replacing any value not yet fetched.
+     */
+    inline void post(const T &value)
+    {
+        _slots[_back] = value;
+        uint32_t previous = _middle.exchange(_back | FRESH_FLAG, std::memory_order_acq_rel);
+        _back = previous & INDEX_MASK;
+    }
+
+    /**
+     * @brief Takes the newest value if one was posted since the last fetch.
+     * @param out Receives the value. Left untouched if there is nothing new.
+     * @return True if a new value was copied into out.
+     */
+    inline bool fetch(T &out)
+    {
+        if ((_middle.load(std::memory_order_acquire) & FRESH_FLAG) == 0)
+            return false;
+        uint32_t previous = _middle.exchange(_front, std::memory_order_acq_rel);
+        _front = previous & INDEX_MASK;
+        out = _slots[_front];
+        return true;
+    }
+
+private:
+    static const uint32_t INDEX_MASK = 0x3;
+    static const uint32_t FRESH_FLAG = 0x4;
+
+    T _slots[3] = {};
+    uint32_t _back = 0;               // Owned by the producer
+    std::atomic<uint32_t> _middle{1}; // Shared, FRESH_FLAG set when unread
+    uint32_t _front = 2;              // Owned by the consumer
+};
+
+#endif // MAILBOX_H
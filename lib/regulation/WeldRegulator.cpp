@@ -0,0 +1,250 @@
+// WeldRegulator.cpp
+
+#include "WeldRegulator.h"
+
+// Longest half-cycle accepted (45Hz mains). Used as the integration cap while
+// the frequency monitor has no period yet.
+#define MAX_HALF_CYCLE_US 11112
+
+WeldRegulator::WeldRegulator()
+    : _pid(&_input, &_output, &_setpoint, 0.25, 0.8, 0.0, DIRECT)
+{
+    // Same starting tunings for every mode; tune each one with setTunings().
+    for (uint8_t i = 0; i < (uint8_t)RegulationMode::COUNT; ++i)
+    {
+        _tunings[i] = {0.25, 0.8, 0.0};
+        _setpoints[i] = 0.0;
+    }
+}
+
+bool WeldRegulator::begin(TriacController *triac, int sampleTime_ms)
+{
+    if (triac == nullptr)
+        return false;
+    _triac = triac;
+
+    _pid.SetSampleTime(sampleTime_ms);
+    _pid.SetOutputLimits(0, 100); // Controller output is 0-100% power
+    setMode(_mode);
+
+    return true;
+}
+
+void WeldRegulator::setMode(RegulationMode mode)
+{
+    if (mode >= RegulationMode::COUNT)
+        return;
+
+    // Leaving or re-entering ENERGY mode always ends the running weld.
+    _weldActive = false;
+
+    _mode = mode;
+    _setpoint = _setpoints[(uint8_t)_mode];
+    _applyTunings();
+
+    // Going through MANUAL makes the PID library re-seed its integrator from
+    // the present output, so the power does not jump on a mode change.
+    _pid.SetMode(MANUAL);
+    _input = _measuredValue(_mode);
+    if (_mode == RegulationMode::ENERGY)
+    {
+        // Nothing is delivered until startWeld() is called; even 0% power
+        // would still fire a short sliver of every half-cycle.
+        _output = 0.0;
+        if (_triac)
+            _triac->disableOutput();
+        return;
+    }
+    _pid.SetMode(AUTOMATIC);
+
+    // A finished or aborted weld leaves the output disabled.
+    if (_triac)
+        _triac->enableOutput();
+}
+
+void WeldRegulator::setTunings(RegulationMode mode, double kp, double ki, double kd)
+{
+    if (mode >= RegulationMode::COUNT)
+        return;
+    _tunings[(uint8_t)mode] = {kp, ki, kd};
+    if (mode == _mode)
+        _applyTunings();
+}
+
+void WeldRegulator::setSetpoint(float setpoint)
+{
+    if (_mode == RegulationMode::ENERGY)
+        return; // Use setEnergyTarget() instead
+    _setpoints[(uint8_t)_mode] = setpoint;
+    _setpoint = setpoint;
+}
+
+bool WeldRegulator::setEnergyTarget(float energy_J, float power_W)
+{
+    // A weld regulated to 0 W would never reach its target nor cut off.
+    if (!(energy_J > 0.0f) || !(power_W > 0.0f))
+        return false;
+
+    _energyTarget_J = energy_J;
+    _energyPower_W = power_W;
+    _setpoints[(uint8_t)RegulationMode::ENERGY] = _energyPower_W;
+    if (_mode == RegulationMode::ENERGY)
+        _setpoint = _energyPower_W;
+    return true;
+}
+
+bool WeldRegulator::startWeld()
+{
+    if (_triac == nullptr || _mode != RegulationMode::ENERGY ||
+        _energyTarget_J <= 0.0 || _energyPower_W <= 0.0)
+        return false;
+
+    _weldActive = false; // Keep the half-cycle callback out while we reset
+    _energy_J = 0.0;
+    _firedHalfCycleEnergy_J = 0.0;
+    _lastHalfCycle_us = 0; // The half-cycle in progress was not fired; skip it
+    _weldStart_us = micros();
+    _weldComplete = false;
+
+    _output = 0.0;
+    _input = _measuredValue(_mode);
+    _pid.SetMode(MANUAL);
+    _pid.SetMode(AUTOMATIC);
+
+    _weldActive = true;
+    _triac->enableOutput();
+    return true;
+}
+
+void WeldRegulator::abortWeld()
+{
+    if (!_weldActive)
+        return;
+    _weldActive = false;
+    if (_triac)
+        _triac->disableOutput();
+}
+
+void WeldRegulator::addSample(float voltage, float current, unsigned long timestamp_us)
+{
+    _voltage = voltage;
+    _current = current;
+    _sampleMailbox.post({voltage, current, timestamp_us});
+}
+
+bool WeldRegulator::compute()
+{
+    if (_triac == nullptr)
+        return false;
+
+    if (_mode == RegulationMode::ENERGY && !_weldActive)
+    {
+        // Idle between welds (or just cut off): hold the output at zero.
+        if (_pid.GetMode() == AUTOMATIC)
+            _pid.SetMode(MANUAL);
+        _output = 0.0;
+        _triac->setPower(0);
+        return false;
+    }
+
+    _input = _measuredValue(_mode);
+    if (!_pid.Compute())
+        return false;
+
+    _triac->setPower(_output);
+    return true;
+}
+
+void WeldRegulator::onHalfCycle(unsigned long timestamp_us)
+{
+    unsigned long last_us = _lastHalfCycle_us;
+    _lastHalfCycle_us = timestamp_us;
+    if (!_weldActive || last_us == 0)
+        return;
+
+    // A missed hardware edge stretches the interval to 1.5 or more half-cycles.
+    // In phase angle nothing after the first half-cycle is fired without that
+    // edge, so the interval is integrated as one half-cycle rather than dropped.
+    // A held burst gate (released by the TriacController watchdog) also finishes
+    // the second half of its cycle, which this then leaves uncounted.
+    unsigned long dt_us = timestamp_us - last_us;
+    float frequency = _triac->getFrequency();
+    unsigned long halfCycle_us = (frequency > 0.0f) ? (unsigned long)(500000.0f / frequency) : MAX_HALF_CYCLE_US;
+    if (halfCycle_us > MAX_HALF_CYCLE_US)
+        halfCycle_us = MAX_HALF_CYCLE_US;
+    if (dt_us > halfCycle_us)
+        dt_us = halfCycle_us;
+
+    _sampleMailbox.fetch(_halfCycleSample);
+
+    // Until the sensor reports a measurement taken after the weld started,
+    // count the half-cycle at the commanded power rather than a stale reading.
+    float power_W;
+    if ((long)(_halfCycleSample.timestamp_us - _weldStart_us) >= 0)
+        power_W = _halfCycleSample.voltage * _halfCycleSample.current;
+    else
+        power_W = _energyPower_W;
+
+    float halfCycleEnergy_J = power_W * (dt_us * 1e-6f);
+    float energy_J = _energy_J + halfCycleEnergy_J;
+    _energy_J = energy_J;
+
+    // The next half-cycle, if it fires, is expected to carry as much as the
+    // last one that measured any energy. With a sensor that reports each
+    // half-cycle, burst off-cycles measure nothing and are skipped here. The
+    // BL0942 reports RMS over a window of several cycles instead, so in burst
+    // mode every half-cycle gets the averaged power and the estimate is that
+    // average. The cutoff is then only as exact as the burst pattern allows.
+    if (halfCycleEnergy_J > 0.0f)
+        _firedHalfCycleEnergy_J = halfCycleEnergy_J;
+    float next_J = _firedHalfCycleEnergy_J;
+
+    // Cut off at the boundary nearest to the target: the firing decision for
+    // the next half-cycle is made right after this callback returns, so the
+    // output stops within one half-cycle and the error stays below half of
+    // one half-cycle's energy.
+    if (energy_J + 0.5f * next_J >= _energyTarget_J)
+    {
+        _triac->disableOutput();
+        _weldActive = false;
+        _weldComplete = true;
+    }
+    else if (energy_J + 1.5f * next_J >= _energyTarget_J)
+    {
+        // The cutoff will come at the next boundary; let the controller know
+        // that the half-cycle starting now is the last one to fire.
+        _triac->setLastHalfCycle();
+    }
+}
+
+// --- Status Functions ---
+RegulationMode WeldRegulator::getMode() const { return _mode; }
+float WeldRegulator::getSetpoint() const { return _setpoint; }
+float WeldRegulator::getInput() const { return _input; }
+float WeldRegulator::getOutput() const { return _output; }
+float WeldRegulator::getDeliveredEnergy() const { return _energy_J; }
+float WeldRegulator::getEnergyTarget() const { return _energyTarget_J; }
+bool WeldRegulator::isWeldActive() const { return _weldActive; }
+bool WeldRegulator::isWeldComplete() const { return _weldComplete; }
+
+// --- Private Methods ---
+float WeldRegulator::_measuredValue(RegulationMode mode) const
+{
+    switch (mode)
+    {
+    case RegulationMode::VOLTAGE:
+        return _voltage;
+    case RegulationMode::CURRENT:
+        return _current;
+    case RegulationMode::POWER:
+    case RegulationMode::ENERGY:
+    default:
+        return _voltage * _current;
+    }
+}
+
+void WeldRegulator::_applyTunings()
+{
+    const Tunings &t = _tunings[(uint8_t)_mode];
+    _pid.SetTunings(t.kp, t.ki, t.kd);
+}
@@ -0,0 +1,155 @@
+// WeldRegulator.h
+
+#ifndef WELD_REGULATOR_H
+#define WELD_REGULATOR_H
+
+#include <Arduino.h>
+#include <PID_v1.h>
+#include "TriacController.h"
+#include "Mailbox.h"
+
+/**
+ * @brief The quantity the regulator closes the loop on.
+ * ENERGY regulates power at a fixed level and cuts the output off once the
+ * delivered energy reaches the target.
+ */
+enum class RegulationMode : uint8_t
+{
+    VOLTAGE = 0,
+    CURRENT,
+    POWER,
+    ENERGY,
+    COUNT
+};
+
+class WeldRegulator
+{
+public:
+    WeldRegulator();
+
+    /**
+     * @brief Initializes the regulator.
+     * @param triac The TRIAC controller used as the actuator (its setPower()).
+     * @param sampleTime_ms The PID compute interval in milliseconds.
+     * @return True on success, false on failure.
+     */
+    bool begin(TriacController *triac, int sampleTime_ms = 50);
+
+    /**
+     * @brief Selects the regulation mode. The switch is bumpless: the PID
+     * integrator is re-seeded from the current power output.
+     */
+    void setMode(RegulationMode mode);
+
+    /**
+     * @brief Sets the PID tunings used while the given mode is active.
+     */
+    void setTunings(RegulationMode mode, double kp, double ki, double kd);
+
+    /**
+     * @brief Sets the setpoint for the VOLTAGE (V), CURRENT (A) or POWER (W) modes.
+     */
+    void setSetpoint(float setpoint);
+
+    /**
+     * @brief Configures the ENERGY mode.
+     * @param energy_J The energy to deliver per weld in Joules.
+     * @param power_W The power the inner loop regulates at while the weld is running.
+     * @return False (and nothing changed) unless both values are above zero.
+     */
+    bool setEnergyTarget(float energy_J, float power_W);
+
+    /**
+     * @brief Starts a weld in ENERGY mode: resets the energy counter and enables the output.
+     * @return False if not in ENERGY mode or no valid energy target is set.
+     */
+    bool startWeld();
+
+    /**
+     * @brief Aborts a running weld and disables the output.
+     */
+    void abortWeld();
+
+    /**
+     * @brief Feeds a new timestamped measurement. Call this whenever the sensor has a reading,
+     * always from the same task.
+     * @param voltage The RMS voltage in Volts.
+     * @param current The RMS current in Amps.
+     * @param timestamp_us The timestamp (from micros()) of the measurement.
+     */
+    void addSample(float voltage, float current, unsigned long timestamp_us);
+
+    /**
+     * @brief Runs one control step and applies the result with setPower(). Call this from loop().
+     * @return True if a new output was computed.
+     */
+    bool compute();
+
+    /**
+     * @brief Integrates the energy of the half-cycle that just ended and applies the
+     * energy cutoff. Attach this (through a free function) with
+     * TriacController::attachHalfCycleCallback(), which calls it from the esp_timer
+     * task only; it is the single consumer of the sample mailbox.
+     * @param timestamp_us The timestamp (from micros()) of the half-cycle boundary.
+     */
+    void onHalfCycle(unsigned long timestamp_us);
+
+    // --- Status ---
+    RegulationMode getMode() const;
+    float getSetpoint() const;
+    float getInput() const;
+    float getOutput() const;
+    float getDeliveredEnergy() const;
+    float getEnergyTarget() const;
+    bool isWeldActive() const;
+    bool isWeldComplete() const;
+
+private:
+    struct Tunings
+    {
+        double kp;
+        double ki;
+        double kd;
+    };
+
+    float _measuredValue(RegulationMode mode) const;
+    void _applyTunings();
+
+    TriacController *_triac = nullptr;
+    RegulationMode _mode = RegulationMode::VOLTAGE;
+    Tunings _tunings[(uint8_t)RegulationMode::COUNT];
+    float _setpoints[(uint8_t)RegulationMode::COUNT];
+
+    // PID state (the PID library works on pointers to these)
+    double _input = 0.0;
+    double _output = 0.0;
+    double _setpoint = 0.0;
+    PID _pid;
+
+    struct Sample
+    {
+        float voltage;
+        float current;
+        unsigned long timestamp_us;
+    };
+
+    // Latest measurement, as seen by the control side
+    float _voltage = 0.0;
+    float _current = 0.0;
+
+    // The same measurement handed to the half-cycle callback, which may run on the other core
+    Mailbox<Sample> _sampleMailbox;
+    Sample _halfCycleSample = {};
+
+    // Energy integration, updated from the half-cycle callback
+    float _energyTarget_J = 0.0;
+    float _energyPower_W = 0.0;
+    volatile float _energy_J = 0.0;
+    float _firedHalfCycleEnergy_J = 0.0; // Energy of the last half-cycle that conducted
+    volatile unsigned long _lastHalfCycle_us = 0;
+    volatile unsigned long _weldStart_us = 0;
+    volatile bool _weldActive = false;
+    volatile bool _weldComplete = false;
+};
+
+#endif // WELD_REGULATOR_H
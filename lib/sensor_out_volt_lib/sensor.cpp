@@ -14,6 +14,7 @@ bl0942::BL0942 blSensor(Serial1);
 // 'volatile' is used to ensure the variables are read correctly from memory.
 volatile float raw_voltage = 0.0;
 volatile float raw_current = 0.0;
+volatile unsigned long raw_sample_time_us = 0;
 
 /**
  * @brief A private callback function that the BL0942 library calls when it has new data.
@@ -24,6 +25,7 @@ void dataReceivedCallback(bl0942::SensorData &data)
 {
   raw_voltage = data.voltage;
   raw_current = data.current;
+  raw_sample_time_us = micros();
 }
 
 /**
@@ -66,4 +68,12 @@ float getVoltage()
 float getCurrent()
 {
   return raw_current;
+}
+
+/**
+ * @brief Gets the timestamp of the latest reading.
+ */
+unsigned long getSampleTime()
+{
+  return raw_sample_time_us;
 }
\ No newline at end of file
@@ -24,4 +24,10 @@ float getVoltage();
  */
 float getCurrent();
 
+/**
+ * @brief Gets the timestamp of the latest reading.
+ * @return The micros() value when the reading arrived, 0 if none has arrived yet.
+ */
+unsigned long getSampleTime();
+
 #endif // SENSOR_H
\ No newline at end of file
@@ -15,6 +15,10 @@ TriacController::~TriacController()
         esp_timer_delete(_stopPulseTimer);
     if (_halfCycleTimer) // <-- ADDED
         esp_timer_delete(_halfCycleTimer);
+    if (_zeroCrossTimer)
+        esp_timer_delete(_zeroCrossTimer);
+    if (_burstWatchdogTimer)
+        esp_timer_delete(_burstWatchdogTimer);
     if (_zcPin >= 0)
         detachInterrupt(digitalPinToInterrupt(_zcPin));
 }
@@ -55,18 +59,34 @@ bool TriacController::begin(int zcPin, int triacPin, float minFreq, float maxFre
     if (esp_timer_create(&half_cycle_timer_args, &_halfCycleTimer) != ESP_OK)
         return false;
 
-    // 5. Initialize the AC Frequency Monitor
+    // 5. Create the timer that runs the zero-cross work deferred from the GPIO ISR
+    const esp_timer_create_args_t zero_cross_timer_args = {
+        .callback = &isr_handleZeroCrossTick,
+        .arg = this,
+        .name = "zero_cross_timer"};
+    if (esp_timer_create(&zero_cross_timer_args, &_zeroCrossTimer) != ESP_OK)
+        return false;
+
+    // 6. Create the timer that drops a held burst gate when the zero-cross edges stop
+    const esp_timer_create_args_t burst_watchdog_timer_args = {
+        .callback = &isr_burstWatchdog,
+        .arg = this,
+        .name = "burst_watchdog_timer"};
+    if (esp_timer_create(&burst_watchdog_timer_args, &_burstWatchdogTimer) != ESP_OK)
+        return false;
+
+    // 7. Initialize the AC Frequency Monitor
     if (!_freqMonitor.begin(filterSize, minFreq, maxFreq))
     {
         return false;
     }
 
-    // 6. Attach the hardware interrupt for the RISING-EDGE-ONLY zero-cross detector
+    // 8. Attach the hardware interrupt for the RISING-EDGE-ONLY zero-cross detector
     pinMode(_zcPin, INPUT_PULLUP);
     // Make sure this is set to RISING, not CHANGE
     attachInterruptArg(digitalPinToInterrupt(_zcPin), isr_handleHardwareZeroCross, this, RISING);
 
-    // 7. Set initial state
+    // 9. Set initial state
     _outputEnabled = true;
     setPower(0);
 
@@ -81,6 +101,11 @@ void TriacController::setPower(float power)
     _firingAngle = _mapPowerToAngle(_powerLevel);
 }
 
+void TriacController::setFiringMode(FiringMode mode)
+{
+    _requestedMode = mode;
+}
+
 void TriacController::setMeasurementDelay(unsigned int delay_us)
 {
     _measurementDelay_us = delay_us;
@@ -99,6 +124,11 @@ void TriacController::enableOutput()
 void TriacController::disableOutput()
 {
     _outputEnabled = false;
+    if (_firingTimer)
+        esp_timer_stop(_firingTimer); // Drop a firing already scheduled for this half-cycle
+    _burstCycleOn = false; // A held burst gate is released too
+    if (_burstWatchdogTimer)
+        esp_timer_stop(_burstWatchdogTimer);
     _stopPulseTrain(); // Immediately stop any ongoing pulse for safety
 }
 
@@ -110,6 +140,27 @@ void TriacController::attachZeroCrossCallback(ZcCallback_t callback)
 }
 // <<< END: ADDED CODE >>>
 
+void TriacController::attachHalfCycleCallback(HalfCycleCallback_t callback)
+{
+    _halfCycleCallback = callback;
+}
+
+void TriacController::setLastHalfCycle()
+{
+    _lastHalfCycle = true;
+}
+
+TriacController::FiringJitterStats TriacController::getFiringJitter()
+{
+    _jitterMailbox.fetch(_jitterSnapshot);
+    return _jitterSnapshot;
+}
+
+void TriacController::resetFiringJitter()
+{
+    _jitterResetRequested = true;
+}
+
 
 // --- Status Functions ---
 // ... (status functions remain unchanged) ...
@@ -117,6 +168,7 @@ bool TriacController::isEnabled() const { return _outputEnabled; }
 bool TriacController::isFaulty() const { return _freqMonitor.isFaulty(); }
 float TriacController::getFrequency() const { return _freqMonitor.getFrequency(); }
 float TriacController::getCurrentPower() const { return _powerLevel; }
+FiringMode TriacController::getFiringMode() const { return _firingMode; }
 
 
 // --- Private Methods ---
@@ -125,7 +177,26 @@ float TriacController::_mapPowerToAngle(float power)
 {
     const float minAngle = 5.0;
     const float maxAngle = 175.0;
-    return maxAngle - (power / 100.0) * (maxAngle - minAngle);
+
+    // A resistive load fired at angle a receives the fraction
+    //   f(a) = 1 - a/pi + sin(2a)/(2pi)
+    // of the full half-cycle energy. Solve f(a) = power/100 so that a power level
+    // means the same load power here as it does in burst mode. f falls
+    // monotonically over [0, pi], so bisection always converges; 16 steps leave
+    // well under 0.01 degrees.
+    float target = power / 100.0f;
+    float lo = minAngle * (float)M_PI / 180.0f;
+    float hi = maxAngle * (float)M_PI / 180.0f;
+    for (int i = 0; i < 16; ++i)
+    {
+        float mid = 0.5f * (lo + hi);
+        float fraction = 1.0f - mid / (float)M_PI + sinf(2.0f * mid) / (2.0f * (float)M_PI);
+        if (fraction > target)
+            lo = mid;
+        else
+            hi = mid;
+    }
+    return 0.5f * (lo + hi) * 180.0f / (float)M_PI;
 }
 
 
@@ -148,13 +219,40 @@ void IRAM_ATTR TriacController::isr_handleHardwareZeroCross(void *arg)
     }
     // <<< END: MODIFIED BLOCK >>>
 
+    // Everything else runs in the esp_timer task, the same context as the
+    // half-cycle and firing timers, so the firing state and the half-cycle
+    // callback are never entered from two contexts at once.
+    esp_timer_start_once(instance->_zeroCrossTimer, 0);
+}
+
+// Runs in the esp_timer task right after the hardware zero-cross ISR
+void IRAM_ATTR TriacController::isr_handleZeroCrossTick(void *arg)
+{
+    TriacController *instance = static_cast<TriacController *>(arg);
+    unsigned long zc_us = instance->_lastZcTime_us;
+
+    if (instance->_halfCycleCallback != nullptr)
+    {
+        instance->_halfCycleCallback(zc_us - instance->_measurementDelay_us);
+    }
+
     // Trigger the firing logic for the rising edge (first half-cycle)
     instance->_onHardwareZeroCross();
-
-    // Now, arm the timer to trigger again at the simulated falling edge
+    instance->_lastHalfCycle = false;
+
+    // A held burst gate may stay on until the next hardware edge, plus some slack.
+    if (instance->_burstCycleOn)
+        instance->_armBurstWatchdog(instance->_freqMonitor.getPeriod());
+
+    // Now, arm the timer to trigger again at the simulated falling edge.
+    // In burst mode it is only needed where the gate changes or to run the
+    // half-cycle callback.
+    bool needHalfCycle = (instance->_firingMode == FiringMode::PHASE_ANGLE) ||
+                         (instance->_halfCycleCallback != nullptr) ||
+                         (instance->_burstNextOn != instance->_burstCycleOn);
     unsigned long half_period_us = instance->_freqMonitor.getPeriod() / 2;
-    long half_cycle_timer_delay = (long)half_period_us - (long)instance->_measurementDelay_us;
-    if (half_cycle_timer_delay > 0)
+    long half_cycle_timer_delay = (long)half_period_us - (long)instance->_measurementDelay_us - (long)(micros() - zc_us);
+    if (needHalfCycle && half_cycle_timer_delay > 0)
     {
         esp_timer_start_once(instance->_halfCycleTimer, half_cycle_timer_delay);
     }
@@ -164,17 +262,43 @@ void IRAM_ATTR TriacController::isr_handleHardwareZeroCross(void *arg)
 // NEW FUNCTION: Called when the half-cycle timer expires
 void IRAM_ATTR TriacController::isr_handleHalfCycle(void *arg)
 {
-    static_cast<TriacController *>(arg)->_onHalfCycle();
+    TriacController *instance = static_cast<TriacController *>(arg);
+    if (instance->_halfCycleCallback != nullptr)
+    {
+        instance->_halfCycleCallback(micros());
+    }
+    instance->_onHalfCycle();
+    instance->_lastHalfCycle = false;
 }
 
 void TriacController::_onHardwareZeroCross()
 {
+    // Cycles run from one falling true zero-cross to the next, so the half-cycle
+    // starting here closes a cycle that began in the mode latched before. Mode
+    // changes are latched here and apply from the next falling zero-cross on.
+    // Nothing is cancelled: a phase-angle firing still pending belongs to the
+    // previous half-cycle, and a gated burst cycle keeps its gate until it ends.
+    FiringMode cycleMode = _firingMode;
+    if (_requestedMode != _firingMode)
+    {
+        _firingMode = _requestedMode;
+        _burstAccumulator = 0.0;
+    }
+    _burstNextOn = false;
+
     if (!_outputEnabled || _freqMonitor.isFaulty())
     {
         esp_timer_stop(_firingTimer);
         return;
     }
 
+    if (_firingMode == FiringMode::BURST)
+        _onBurstZeroCross();
+
+    // The second half of a burst cycle is already gated, or stays off.
+    if (cycleMode == FiringMode::BURST)
+        return;
+
     unsigned long half_period_us = _freqMonitor.getPeriod() / 2;
     if (half_period_us == 0)
         return;
@@ -182,11 +306,12 @@ void TriacController::_onHardwareZeroCross()
     unsigned long angle_delay_us = (unsigned long)((_firingAngle / 180.0) * half_period_us);
 
     // For the hardware-detected ZC, we must compensate for the detector's delay
-    long timer_delay_us = (long)angle_delay_us - (long)_measurementDelay_us;
+    // and for the time it took the timer task to pick up the edge
+    long timer_delay_us = (long)angle_delay_us - (long)_measurementDelay_us - (long)(micros() - _lastZcTime_us);
 
     if (timer_delay_us > 50)
     {
-        esp_timer_start_once(_firingTimer, timer_delay_us);
+        _startFiringTimer(timer_delay_us);
     }
     else
     {
@@ -197,12 +322,17 @@ void TriacController::_onHardwareZeroCross()
 // NEW FUNCTION: Handles the firing logic for the simulated falling edge
 void TriacController::_onHalfCycle()
 {
+    _onBurstCycleStart();
+
     if (!_outputEnabled || _freqMonitor.isFaulty())
     {
         esp_timer_stop(_firingTimer);
         return;
     }
 
+    if (_firingMode == FiringMode::BURST)
+        return;
+
     unsigned long half_period_us = _freqMonitor.getPeriod() / 2;
     if (half_period_us == 0)
         return;
@@ -213,7 +343,7 @@ void TriacController::_onHalfCycle()
     // We simply use the calculated angle delay directly.
     if (angle_delay_us > 50)
     {
-        esp_timer_start_once(_firingTimer, angle_delay_us);
+        _startFiringTimer(angle_delay_us);
     }
     else
     {
@@ -221,6 +351,101 @@ void TriacController::_onHalfCycle()
     }
 }
 
+void TriacController::_onBurstZeroCross()
+{
+    // The hardware edge arrives _measurementDelay_us after the true zero-cross,
+    // so firing is left to the half-cycle timer, which lands on the next true
+    // zero-cross. Here we only decide whether the coming cycle is on: add the
+    // requested power every cycle and fire whenever a whole cycle's worth has
+    // accumulated, carrying the remainder. This spreads the on-cycles as evenly
+    // as possible and keeps the long-run average exact.
+    _burstAccumulator += _powerLevel;
+    _burstNextOn = (_burstAccumulator >= 100.0);
+    if (_burstNextOn)
+        _burstAccumulator -= 100.0;
+}
+
+void TriacController::_onBurstCycleStart()
+{
+    // A burst cycle ends and the next one starts at this true zero-cross. The
+    // gate is held on (pulse train running, no stop timer) for as long as
+    // consecutive cycles are on, and only switched where a run starts or ends.
+    // A cycle that ends here has conducted both halves, because only an energy
+    // cutoff (disableOutput() or setLastHalfCycle()) ends a run in between.
+    bool on = _burstNextOn && _firingMode == FiringMode::BURST &&
+              _outputEnabled && !_freqMonitor.isFaulty();
+    if (on && _lastHalfCycle)
+    {
+        // Only this half is wanted: a normal pulse latches the TRIAC for it and
+        // ends before the rising zero-cross, releasing a held gate as well.
+        _fireTriac();
+        on = false;
+    }
+    else if (on && !_burstCycleOn)
+    {
+        esp_timer_stop(_stopPulseTimer); // A late phase-angle pulse must not end the run
+        ledcWrite(LEDC_CHANNEL, LEDC_DUTY_CYCLE);
+    }
+    else if (!on && _burstCycleOn)
+        _stopPulseTrain();
+    _burstCycleOn = on;
+    _burstNextOn = false;
+
+    if (!on)
+    {
+        esp_timer_stop(_burstWatchdogTimer);
+        return;
+    }
+
+    // disableOutput() may have run on the control core between the check above
+    // and switching the gate on; it must not be undone until the next cycle.
+    if (!_outputEnabled)
+    {
+        _burstCycleOn = false;
+        _stopPulseTrain();
+        return;
+    }
+    // The next hardware edge is half a period plus the detector delay away.
+    _armBurstWatchdog(_freqMonitor.getPeriod() / 2 + _measurementDelay_us);
+}
+
+void TriacController::_armBurstWatchdog(unsigned long nextEdge_us)
+{
+    // Nothing but the zero-cross edges ends a held gate, and a lost detector
+    // signal does not make the frequency monitor faulty (it only sees edges).
+    // If the next hardware edge has not come shortly after it was due, the
+    // mains or the detector is gone. The edge lags the true zero-cross by the
+    // detector delay, so dropping the gate then still lets the cycle in
+    // progress finish both of its halves.
+    esp_timer_stop(_burstWatchdogTimer);
+    esp_timer_start_once(_burstWatchdogTimer, nextEdge_us + BURST_WATCHDOG_MARGIN_US);
+}
+
+void TriacController::_startFiringTimer(long delay_us)
+{
+    _firingDue_us = micros() + delay_us;
+    esp_timer_start_once(_firingTimer, delay_us);
+}
+
+void IRAM_ATTR TriacController::_recordFiringJitter()
+{
+    if (_jitterResetRequested)
+    {
+        _jitterResetRequested = false;
+        _jitter = {};
+    }
+
+    long late_us = (long)(micros() - _firingDue_us);
+    if (late_us < 0)
+        late_us = 0;
+
+    _jitter.count++;
+    _jitter.totalLate_us += late_us;
+    if ((unsigned long)late_us > _jitter.maxLate_us)
+        _jitter.maxLate_us = late_us;
+    _jitterMailbox.post(_jitter);
+}
+
 void IRAM_ATTR TriacController::_fireTriac()
 {
     ledcWrite(LEDC_CHANNEL, LEDC_DUTY_CYCLE);
@@ -234,10 +459,22 @@ void IRAM_ATTR TriacController::_stopPulseTrain()
 
 void IRAM_ATTR TriacController::isr_fireTriac(void *arg)
 {
-    static_cast<TriacController *>(arg)->_fireTriac();
+    TriacController *instance = static_cast<TriacController *>(arg);
+    instance->_fireTriac();
+    instance->_recordFiringJitter();
 }
 
 void IRAM_ATTR TriacController::isr_stopPulseTrain(void *arg)
 {
     static_cast<TriacController *>(arg)->_stopPulseTrain();
+}
+
+void IRAM_ATTR TriacController::isr_burstWatchdog(void *arg)
+{
+    TriacController *instance = static_cast<TriacController *>(arg);
+    if (instance->_burstCycleOn)
+    {
+        instance->_burstCycleOn = false;
+        instance->_stopPulseTrain();
+    }
 }
\ No newline at end of file
@@ -4,6 +4,7 @@
 #define TRIAC_CONTROLLER_H
 
 #include "ACFrequencyMonitor.h"
+#include "Mailbox.h"
 
 // --- Default Configuration for the Pulse Train ---
 #define LEDC_CHANNEL 0              // ESP32 LEDC channel 0
@@ -11,6 +12,21 @@
 #define LEDC_RESOLUTION 8           // 8-bit resolution (0-255)
 #define LEDC_DUTY_CYCLE 128         // 50% duty cycle for the pulses
 #define PULSE_TRAIN_DURATION_US 200 // Duration of the pulse burst in microseconds
+#define BURST_WATCHDOG_MARGIN_US 2000 // Slack past the next expected edge before a held burst gate is dropped
+
+/**
+ * @brief How the TRIAC is fired.
+ * PHASE_ANGLE fires every half-cycle at an angle set by the power level.
+ * BURST fires whole cycles right at the zero-cross and sets the power by the
+ * fraction of cycles that are on (integral-cycle control, for resistive loads).
+ * The gate is held on through a run of on-cycles, so timer work is only needed
+ * where a run starts or ends.
+ */
+enum class FiringMode : uint8_t
+{
+    PHASE_ANGLE = 0,
+    BURST
+};
 
 class TriacController
 {
@@ -21,6 +37,25 @@ public:
      * @param timestamp_us The timestamp (from micros()) when the ZC event occurred.
      */
     using ZcCallback_t = void (*)(unsigned long timestamp_us);
+
+    /**
+     * @brief Defines the function signature for the half-cycle boundary callback.
+     * It is invoked at the start of every half-cycle (hardware and simulated edge),
+     * before the firing decision for that half-cycle is made.
+     * @param timestamp_us The timestamp (from micros()) of the true zero-cross that
+     * starts the half-cycle, i.e. the hardware edge minus the measurement delay.
+     */
+    using HalfCycleCallback_t = void (*)(unsigned long timestamp_us);
+
+    /**
+     * @brief How late the firing timer ran compared with its scheduled time.
+     */
+    struct FiringJitterStats
+    {
+        unsigned long count;        // Number of timer-driven firings measured
+        unsigned long maxLate_us;   // Worst lateness seen
+        unsigned long totalLate_us; // Sum of lateness, for the average
+    };
     // <<< END: ADDED CODE >>>
 
     TriacController();
@@ -39,10 +74,19 @@ public:
 
     /**
      * @brief Sets the power output to the load.
-     * @param power The desired power level from 0.0 (off) to 100.0 (full on).
+     * @param power The desired power level from 0.0 (off) to 100.0 (full on), as a
+     * share of full-wave power into a resistive load. Both firing modes deliver
+     * the same power for the same level, so a mode switch does not step the load.
      */
     void setPower(float power);
 
+    /**
+     * @brief Selects phase-angle or burst firing. The switch is latched at the next
+     * hardware zero-cross and applied from the falling zero-cross after it, where
+     * burst cycles start, so no cycle is ever split between the two modes.
+     */
+    void setFiringMode(FiringMode mode);
+
     /**
      * @brief Sets the known hardware delay of the zero-cross detector.
      * @param delay_us The delay in microseconds (e.g., 750).
@@ -74,18 +118,49 @@ public:
     void attachZeroCrossCallback(ZcCallback_t callback);
     // <<< END: ADDED CODE >>>
 
+    /**
+     * @brief Attaches a callback that runs at every half-cycle boundary. It always
+     * runs in the esp_timer task, never in the GPIO interrupt.
+     * Calling disableOutput() from inside the callback suppresses firing for
+     * that same half-cycle, which is what the energy cutoff relies on.
+     * @param callback The function to call, or nullptr to detach.
+     */
+    void attachHalfCycleCallback(HalfCycleCallback_t callback);
+
+    /**
+     * @brief Marks the half-cycle starting at this boundary as the last one to fire.
+     * Call it from the half-cycle callback, then disableOutput() at the next boundary.
+     * Only burst mode needs it: a burst gate is held across the rising zero-cross,
+     * which is reported late (after the detector delay), so without it the second
+     * half of the cycle would already be fired when the cutoff arrives.
+     */
+    void setLastHalfCycle();
+
+
+    /**
+     * @brief Returns the latest firing jitter statistics published by the firing side.
+     * Safe to call from another core than the one running the timers.
+     */
+    FiringJitterStats getFiringJitter();
+
+    /**
+     * @brief Restarts the firing jitter statistics at the next firing.
+     */
+    void resetFiringJitter();
 
     // --- Status Functions ---
     bool isEnabled() const;
     bool isFaulty() const;
     float getFrequency() const;
     float getCurrentPower() const;
+    FiringMode getFiringMode() const;
 
 private:
     // <<< START: ADDED CODE >>>
     // Callback function pointer for external zero-cross event handling
     ZcCallback_t _zcCallback = nullptr;
     // <<< END: ADDED CODE >>>
+    HalfCycleCallback_t _halfCycleCallback = nullptr;
 
     // Internal instance of the frequency monitor
     ACFrequencyMonitor _freqMonitor;
@@ -94,15 +169,35 @@ private:
     int _zcPin = -1;
     int _triacPin = -1;
     unsigned int _measurementDelay_us = 0;
-    bool _outputEnabled = false;
-    float _powerLevel = 0.0;
-    float _firingAngle = 180.0;
+    volatile bool _outputEnabled = false;
+    volatile float _powerLevel = 0.0;
+    volatile float _firingAngle = 180.0; // Written by the control core, read by the firing core
     volatile unsigned long _lastZcTime_us = 0;
 
+    // Burst firing state. The requested mode is latched into _firingMode at the
+    // hardware zero-cross; the accumulator is a first-order sigma-delta modulator.
+    // A burst cycle runs from one falling true zero-cross to the next: it is
+    // decided at the hardware zero-cross before it and gated at its start.
+    volatile FiringMode _requestedMode = FiringMode::PHASE_ANGLE;
+    FiringMode _firingMode = FiringMode::PHASE_ANGLE;
+    float _burstAccumulator = 0.0;
+    volatile bool _burstCycleOn = false; // Gate held on for the burst cycle in progress
+    bool _burstNextOn = false;           // Decision for the burst cycle about to start
+    bool _lastHalfCycle = false;         // Set by the half-cycle callback, for one boundary
+
+    // Firing jitter, accumulated on the firing core and published through the mailbox
+    unsigned long _firingDue_us = 0;
+    FiringJitterStats _jitter = {};
+    FiringJitterStats _jitterSnapshot = {};
+    Mailbox<FiringJitterStats> _jitterMailbox;
+    volatile bool _jitterResetRequested = false;
+
     // ESP32 hardware timer handles
     esp_timer_handle_t _firingTimer = nullptr;
     esp_timer_handle_t _stopPulseTimer = nullptr;
     esp_timer_handle_t _halfCycleTimer = nullptr; // <-- ADDED: Timer for the falling edge
+    esp_timer_handle_t _zeroCrossTimer = nullptr; // Deferred zero-cross work, run by the esp_timer task
+    esp_timer_handle_t _burstWatchdogTimer = nullptr; // Drops a held burst gate if the edges stop
 
     // Private helper methods
     float _mapPowerToAngle(float power);
@@ -110,12 +205,19 @@ private:
     // Static ISR wrappers required for C-style callbacks
     static void IRAM_ATTR isr_handleHardwareZeroCross(void *arg);
     static void IRAM_ATTR isr_handleHalfCycle(void *arg); // <-- ADDED: ISR for the falling edge timer
+    static void IRAM_ATTR isr_handleZeroCrossTick(void *arg);
     static void IRAM_ATTR isr_fireTriac(void *arg);
     static void IRAM_ATTR isr_stopPulseTrain(void *arg);
+    static void IRAM_ATTR isr_burstWatchdog(void *arg);
 
     // Member function implementations for ISRs
     void _onHardwareZeroCross();
     void _onHalfCycle(); // <-- ADDED: Handler for the falling edge
+    void _onBurstZeroCross();
+    void _onBurstCycleStart();
+    void _armBurstWatchdog(unsigned long nextEdge_us);
+    void _startFiringTimer(long delay_us);
+    void _recordFiringJitter();
     void _fireTriac();
     void _stopPulseTrain();
 };
@@ -1,91 +1,384 @@
 #include <Arduino.h>
 #include "TriacController.h"
-#include <PID_v1.h> // Include the PID library
+#include "WeldRegulator.h"
+#include "Mailbox.h"
 #include "sensor.h"
+#include "execution_model.h"
 // Pin definitions
 #define ZC_INPUT_PIN 14
 #define TRIAC_OUTPUT_PIN 48
 #define VOLTAGE_ADC_PIN 1
 
 // --- PID Controller Setup ---
-double Setpoint, Input, Output;
+// Gains are in % power per unit of error, so each mode needs its own scale:
+// a volt, an amp and a watt of error are very different amounts.
+double Kp = 0.25; // Voltage mode, per V
+double Ki = 0.8;
+double Kd = 0;
 
-double Kp = 0.25;  
-double Ki = 0.8; 
-double Kd = 0; 
+double KpCurrent = 0.1; // Current mode, per A
+double KiCurrent = 2.0;
+double KdCurrent = 0;
+
+double KpPower = 0.01; // Power and energy modes, per W
+double KiPower = 0.2;
+double KdPower = 0;
 
-// Create a PID controller object
-PID myPID(&Input, &Output, &Setpoint, Kp, Ki, Kd, DIRECT);
 TriacController controller;
+WeldRegulator regulator;
+
+// A Serial command line queued to the control side, or an error reply queued back.
+struct Command
+{
+  char text[48];
+};
+
+// A status snapshot, handed from the control side to the comms side.
+struct Telemetry
+{
+  RegulationMode mode;
+  FiringMode firingMode;
+  float setpoint;
+  float input;
+  float output;
+  float energy;
+  float energyTarget;
+  bool weldComplete;
+  float frequency;
+  TriacController::FiringJitterStats jitter;
+};
+
+// Commands are events and must all arrive (an abort cannot be overwritten by a
+// later line), so they go through a queue; telemetry is state, latest wins.
+#define COMMAND_QUEUE_LENGTH 8
+QueueHandle_t commandQueue = nullptr;
+QueueHandle_t replyQueue = nullptr;
+Mailbox<Telemetry> telemetryMailbox;
+
+// Extra filler lines printed per status line, to load the comms path on purpose.
+int telemetryLoadLines = 0;
 
-double getCalibratedRMSVoltage()
+// Runs at every half-cycle boundary; integrates energy and applies the cutoff.
+void onHalfCycle(unsigned long timestamp_us)
 {
+  regulator.onHalfCycle(timestamp_us);
+}
+
+// Feeds the latest sensor reading to the regulator, once per new reading.
+void feedSensorSample()
+{
+  static unsigned long lastSampleTime = 0;
+
   updateSensor();
-  // Apply calibration factor
-  return getVoltage() ;
+  unsigned long sampleTime = getSampleTime();
+  if (sampleTime != lastSampleTime)
+  {
+    lastSampleTime = sampleTime;
+    regulator.addSample(getVoltage(), getCurrent(), sampleTime);
+  }
 }
 
-void setup()
+// Serial commands:
+//   <number>      voltage setpoint (V)
+//   V<number>     voltage mode, setpoint in V
+//   I<number>     current mode, setpoint in A
+//   P<number>     power mode, setpoint in W
+//   E<J> <W>      energy mode, <J> Joules per weld delivered at <W> Watts
+//   W             start a weld (energy mode)
+//   X             abort the running weld
+//   B<0|1>        firing mode: 0 = phase angle, 1 = burst (whole cycles)
+//   J             reset the firing jitter statistics
+//   K<p> <i> <d>  PID tunings for the active mode
+//   T<n>          print <n> extra filler lines per status line (telemetry load test)
+// Returns an error message for the comms side to print, or nullptr on success.
+const char *handleCommand(String inputString)
 {
-  Serial.begin(115200);
-  Serial.println("TRIAC PID Voltage Controller");
+  inputString.trim();
+  if (inputString.length() == 0)
+    return nullptr;
 
-  initSensor();
+  char cmd = toupper(inputString.charAt(0));
+  String args = isAlpha(cmd) ? inputString.substring(1) : inputString;
+  args.trim();
 
-  // Initialize TriacController
-  uint8_t myFilterSize = 7;
-  if (!controller.begin(ZC_INPUT_PIN, TRIAC_OUTPUT_PIN, 45.0, 65.0, myFilterSize))
+  switch (cmd)
   {
-    Serial.println("Failed to initialize Triac Controller!");
-    while (1)
-      ; // Halt on failure
+  case 'I':
+    regulator.setMode(RegulationMode::CURRENT);
+    regulator.setSetpoint(args.toFloat());
+    break;
+  case 'P':
+    regulator.setMode(RegulationMode::POWER);
+    regulator.setSetpoint(args.toFloat());
+    break;
+  case 'E':
+  {
+    float energy = args.toFloat();
+    int space = args.indexOf(' ');
+    float power = (space > 0) ? args.substring(space + 1).toFloat() : 0;
+    if (!regulator.setEnergyTarget(energy, power))
+      return "E needs <J> <W>, both above zero";
+    regulator.setMode(RegulationMode::ENERGY);
+    break;
   }
+  case 'W':
+    if (!regulator.startWeld())
+      return "W needs energy mode with a valid E target";
+    break;
+  case 'X':
+    regulator.abortWeld();
+    break;
+  case 'B':
+    controller.setFiringMode(args.toInt() ? FiringMode::BURST : FiringMode::PHASE_ANGLE);
+    break;
+  case 'J':
+    controller.resetFiringJitter();
+    break;
+  case 'K':
+  {
+    double kp, ki, kd;
+    if (sscanf(args.c_str(), "%lf %lf %lf", &kp, &ki, &kd) != 3 || kp < 0 || ki < 0 || kd < 0)
+      return "K needs <p> <i> <d>, none negative";
+    regulator.setTunings(regulator.getMode(), kp, ki, kd);
+    break;
+  }
+  case 'V':
+  {
+    float newSetpoint = args.toFloat();
+    if (newSetpoint < 0)
+      return "Voltage setpoint must not be negative";
+    regulator.setMode(RegulationMode::VOLTAGE);
+    regulator.setSetpoint(newSetpoint);
+    break;
+  }
+  default:
+  {
+    // Only a bare number is a voltage setpoint; unknown letters are rejected so
+    // a typo cannot drop a running weld to 0V.
+    if (!isDigit(cmd) && cmd != '.')
+      return "Unknown command";
+    float newSetpoint = args.toFloat();
+    regulator.setMode(RegulationMode::VOLTAGE);
+    regulator.setSetpoint(newSetpoint);
+    break;
+  }
+  }
+  return nullptr;
+}
 
-  controller.setMeasurementDelay(3000);
-  controller.setLowPassFilterAlpha(0.99);
-
-  // --- Initialize PID Controller ---
-  Setpoint = 0.0;                // Start with a target voltage of 0
-  myPID.SetMode(AUTOMATIC);      // Turn the PID on
-  myPID.SetSampleTime(50);       // Set PID compute interval to 50ms
-  myPID.SetOutputLimits(0, 100); // Controller output is 0-100% power
+// One pass of the control side: commands, sensor, regulator, status snapshot.
+void controlStep()
+{
+  Command command;
+  while (xQueueReceive(commandQueue, &command, 0) == pdTRUE)
+  {
+    const char *error = handleCommand(String(command.text));
+    if (error != nullptr)
+    {
+      // Hand the error back to the comms side, which owns Serial output.
+      Command reply;
+      snprintf(reply.text, sizeof(reply.text), "%s", error);
+      xQueueSend(replyQueue, &reply, 0);
+    }
+  }
 
-  // Enable the TRIAC output
-  controller.setPower(0);
-  controller.enableOutput();
+  feedSensorSample();
+  regulator.compute();
 
-  Serial.println("Setup complete. Enter target voltage in Serial Monitor.");
+  Telemetry telemetry;
+  telemetry.mode = regulator.getMode();
+  telemetry.firingMode = controller.getFiringMode();
+  telemetry.setpoint = regulator.getSetpoint();
+  telemetry.input = regulator.getInput();
+  telemetry.output = regulator.getOutput();
+  telemetry.energy = regulator.getDeliveredEnergy();
+  telemetry.energyTarget = regulator.getEnergyTarget();
+  telemetry.weldComplete = regulator.isWeldComplete();
+  telemetry.frequency = controller.getFrequency();
+  telemetry.jitter = controller.getFiringJitter();
+  telemetryMailbox.post(telemetry);
 }
 
-void loop()
+// One pass of the comms side: read Serial commands and print status periodically.
+void commsStep()
 {
-  // Check for new setpoint from Serial monitor
+  // Check for a new command from Serial monitor
   if (Serial.available() > 0)
   {
     String inputString = Serial.readStringUntil('\n');
-    float newSetpoint = inputString.toFloat();
-    if (newSetpoint >= 0)
+    inputString.trim();
+    if (inputString.length() > 0 && toupper(inputString.charAt(0)) == 'T')
+    {
+      telemetryLoadLines = max(0L, inputString.substring(1).toInt());
+    }
+    else
     {
-      Setpoint = newSetpoint;
-      Serial.print("New Setpoint received: ");
-      Serial.println(Setpoint);
+      Command command;
+      strlcpy(command.text, inputString.c_str(), sizeof(command.text));
+      if (xQueueSend(commandQueue, &command, 0) != pdTRUE)
+      {
+        Serial.printf("Command dropped (queue full): %s\n", inputString.c_str());
+        inputString = "";
+      }
     }
+    if (inputString.length() > 0)
+      Serial.printf("Command: %s\n", inputString.c_str());
   }
 
-  // Update PID control loop
-  Input = getCalibratedRMSVoltage(); // Read current voltage
-  myPID.Compute();                   // Calculate required power
-  controller.setPower(Output);       // Apply power to TRIAC
+  Command reply;
+  while (xQueueReceive(replyQueue, &reply, 0) == pdTRUE)
+  {
+    Serial.printf("Command error: %s\n", reply.text);
+  }
 
   // Print status periodically for debugging
   static unsigned long lastPrintTime = 0;
+  static Telemetry telemetry = {};
+  telemetryMailbox.fetch(telemetry);
   if (millis() - lastPrintTime > 200)
   {
     lastPrintTime = millis();
-    Serial.printf("Setpoint: %.1fV, Current: %.1fV, PID Out (Power): %.1f%%, Freq: %.2fHz\n",
-                  Setpoint,
-                  Input,
-                  Output,
-                  controller.getFrequency());
+    unsigned long avgLate_us = telemetry.jitter.count ? telemetry.jitter.totalLate_us / telemetry.jitter.count : 0;
+    Serial.printf("Mode: %d%s, Setpoint: %.1f, Measured: %.1f, PID Out (Power): %.1f%%, Energy: %.1f/%.1fJ%s, Freq: %.2fHz, Jitter: avg %luus max %luus\n",
+                  (int)telemetry.mode,
+                  telemetry.firingMode == FiringMode::BURST ? " (burst)" : "",
+                  telemetry.setpoint,
+                  telemetry.input,
+                  telemetry.output,
+                  telemetry.energy,
+                  telemetry.energyTarget,
+                  telemetry.weldComplete ? " (done)" : "",
+                  telemetry.frequency,
+                  avgLate_us,
+                  telemetry.jitter.maxLate_us);
+    for (int i = 0; i < telemetryLoadLines; ++i)
+    {
+      Serial.printf("[LOAD] %03d %.3f %.3f %.3f %.3f\n", i, telemetry.input, telemetry.output, telemetry.energy, telemetry.frequency);
+    }
+  }
+}
+
+bool beginController()
+{
+  // Initialize TriacController
+  uint8_t myFilterSize = 7;
+  if (!controller.begin(ZC_INPUT_PIN, TRIAC_OUTPUT_PIN, 45.0, 65.0, myFilterSize))
+    return false;
+
+  controller.setMeasurementDelay(3000);
+  controller.setLowPassFilterAlpha(0.99);
+  controller.attachHalfCycleCallback(onHalfCycle);
+  return true;
+}
+
+#if EXEC_PARTITIONED
+TaskHandle_t setupTaskHandle = nullptr;
+bool controllerReady = false;
+BaseType_t timerTaskCore = -1;
+
+// The GPIO interrupt is allocated on the core that attaches it, so the
+// controller is started from a short-lived task pinned to the firing core.
+void firingInitTask(void *)
+{
+  controllerReady = beginController();
+
+  TaskHandle_t timerTask = xTaskGetHandle("esp_timer");
+  if (timerTask != nullptr)
+  {
+    vTaskPrioritySet(timerTask, FIRING_TIMER_TASK_PRIORITY);
+    timerTaskCore = xTaskGetAffinity(timerTask);
+  }
+
+  xTaskNotifyGive(setupTaskHandle);
+  vTaskDelete(nullptr);
+}
+
+void controlTask(void *)
+{
+  TickType_t lastWake = xTaskGetTickCount();
+  for (;;)
+  {
+    controlStep();
+    vTaskDelayUntil(&lastWake, pdMS_TO_TICKS(CONTROL_PERIOD_MS));
+  }
+}
+
+void commsTask(void *)
+{
+  for (;;)
+  {
+    commsStep();
+    vTaskDelay(1);
   }
-}
\ No newline at end of file
+}
+#endif
+
+void setup()
+{
+  Serial.begin(115200);
+  Serial.println("TRIAC PID Weld Controller");
+
+  initSensor();
+
+  commandQueue = xQueueCreate(COMMAND_QUEUE_LENGTH, sizeof(Command));
+  replyQueue = xQueueCreate(COMMAND_QUEUE_LENGTH, sizeof(Command));
+  if (commandQueue == nullptr || replyQueue == nullptr)
+  {
+    Serial.println("Failed to create the command queues!");
+    while (1)
+      ; // Halt on failure
+  }
+
+#if EXEC_PARTITIONED
+  setupTaskHandle = xTaskGetCurrentTaskHandle();
+  xTaskCreatePinnedToCore(firingInitTask, "firing_init", 4096, nullptr, configMAX_PRIORITIES - 1, nullptr, FIRING_CORE);
+  ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+  bool ok = controllerReady;
+#else
+  bool ok = beginController();
+#endif
+  if (!ok)
+  {
+    Serial.println("Failed to initialize Triac Controller!");
+    while (1)
+      ; // Halt on failure
+  }
+
+  // --- Initialize the regulator (PID over TriacController::setPower) ---
+  regulator.setTunings(RegulationMode::VOLTAGE, Kp, Ki, Kd);
+  regulator.setTunings(RegulationMode::CURRENT, KpCurrent, KiCurrent, KdCurrent);
+  regulator.setTunings(RegulationMode::POWER, KpPower, KiPower, KdPower);
+  regulator.setTunings(RegulationMode::ENERGY, KpPower, KiPower, KdPower);
+  regulator.begin(&controller, 50); // PID compute interval of 50ms
+  regulator.setMode(RegulationMode::VOLTAGE);
+  regulator.setSetpoint(0.0); // Start with a target voltage of 0
+
+  // Enable the TRIAC output
+  controller.setPower(0);
+  controller.enableOutput();
+
+#if EXEC_PARTITIONED
+  xTaskCreatePinnedToCore(controlTask, "control", CONTROL_TASK_STACK, nullptr, CONTROL_TASK_PRIORITY, nullptr, CONTROL_CORE);
+  xTaskCreatePinnedToCore(commsTask, "comms", COMMS_TASK_STACK, nullptr, COMMS_TASK_PRIORITY, nullptr, CONTROL_CORE);
+  Serial.printf("Execution model: firing on core %d, control and comms on core %d\n", FIRING_CORE, CONTROL_CORE);
+  if (timerTaskCore != FIRING_CORE)
+  {
+    Serial.printf("Warning: esp_timer task runs on core %d, not on the firing core\n", (int)timerTaskCore);
+  }
+#else
+  Serial.println("Execution model: legacy (everything in loop())");
+#endif
+
+  Serial.println("Setup complete. Enter target voltage in Serial Monitor.");
+}
+
+void loop()
+{
+#if EXEC_PARTITIONED
+  // All work runs in the pinned tasks created by setup().
+  vTaskDelete(nullptr);
+#else
+  controlStep();
+  commsStep();
+#endif
+}
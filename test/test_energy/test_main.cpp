@@ -0,0 +1,172 @@
+// Host tests for the ENERGY regulation mode: TriacController and WeldRegulator
+// run together over a simulated resistive load on a clean 50Hz mains, with
+// WeldRegulator::onHalfCycle() attached as the half-cycle callback.
+//
+//   pio test -e native_test -f test_energy
+
+#include <Arduino.h>
+#include <unity.h>
+#include "TriacController.h"
+#include "WeldRegulator.h"
+
+namespace
+{
+    const unsigned long PERIOD_US = 20000;
+    const unsigned long HALF_PERIOD_US = PERIOD_US / 2;
+    const unsigned long STEP_US = 1000;     // Control task period
+    const double FULL_POWER_W = 2000.0;     // Power with the TRIAC fully on
+    const double LOAD_OHMS = 0.05;
+    const float WELD_POWER_W = 1000.0;
+
+    // The simulated sensor reports, at every true zero-cross, the RMS voltage
+    // and current of the half-cycle that just ended. Energy in a half-cycle
+    // fired at offset o: the integral of sin^2 from the firing angle to pi.
+    double halfCycleEnergy(long firedAt_us)
+    {
+        if (firedAt_us < 0)
+            return 0.0;
+        double theta = M_PI * firedAt_us / HALF_PERIOD_US;
+        double fraction = 1.0 - theta / M_PI + sin(2.0 * theta) / (2.0 * M_PI);
+        return FULL_POWER_W * fraction * HALF_PERIOD_US * 1e-6;
+    }
+
+    struct Weld;
+    Weld *g_weld = nullptr;
+    void onHalfCycle(unsigned long timestamp_us);
+
+    struct Weld
+    {
+        TriacController triac;
+        WeldRegulator regulator;
+        unsigned int delay_us;
+        unsigned long zc_us = 1000000; // Last hardware zero-cross
+        unsigned long now_us = 1000000;
+        unsigned long cutoff_us = 0;  // Half-cycle boundary at which the weld completed
+        double delivered_J = 0.0;     // Energy the load really received since startWeld()
+        double lastFired_J = 0.0;     // Energy of the last half-cycle that conducted
+
+        Weld(unsigned int measurementDelay_us, FiringMode mode) : delay_us(measurementDelay_us)
+        {
+            g_weld = this;
+            host::setMicros(now_us);
+            triac.begin(14, 48);
+            triac.setMeasurementDelay(delay_us);
+            triac.setFiringMode(mode);
+            triac.attachHalfCycleCallback(onHalfCycle);
+            regulator.setTunings(RegulationMode::ENERGY, 0.01, 0.2, 0.0);
+            regulator.begin(&triac, 50);
+            triac.enableOutput();
+        }
+
+        ~Weld() { g_weld = nullptr; }
+
+        // Advances the simulation by one control step: sensor, timers, zero-cross, control.
+        void step(bool count)
+        {
+            now_us += STEP_US;
+            if ((now_us + delay_us - zc_us) % HALF_PERIOD_US == 0)
+            {
+                long firedAt_us = host::firstGateOn(now_us - HALF_PERIOD_US, now_us);
+                double energy_J = halfCycleEnergy(firedAt_us);
+                if (count)
+                    delivered_J += energy_J;
+                if (energy_J > 0.0)
+                    lastFired_J = energy_J;
+                double voltage = sqrt(energy_J / (HALF_PERIOD_US * 1e-6) * LOAD_OHMS);
+                regulator.addSample(voltage, voltage / LOAD_OHMS, now_us);
+            }
+            host::runTimersUntil(now_us);
+            if (now_us - zc_us == PERIOD_US)
+            {
+                zc_us = now_us;
+                host::zeroCrossIsr()(host::zeroCrossArg());
+                host::runTimersUntil(now_us);
+            }
+            regulator.compute();
+        }
+
+        // Runs one weld of energy_J and returns once it has completed.
+        void run(float energy_J)
+        {
+            // Lock the frequency monitor first, idle in energy mode.
+            regulator.setEnergyTarget(energy_J, WELD_POWER_W);
+            regulator.setMode(RegulationMode::ENERGY);
+            for (int i = 0; i < 64 * 20; ++i)
+                step(false);
+
+            host::clearGateLog();
+            TEST_ASSERT_TRUE(regulator.startWeld());
+            unsigned long limit = (unsigned long)(4.0 * energy_J / WELD_POWER_W * 1000.0) + 2000;
+            for (unsigned long i = 0; i < limit && !regulator.isWeldComplete(); ++i)
+                step(true);
+            TEST_ASSERT_TRUE_MESSAGE(regulator.isWeldComplete(), "weld did not complete");
+
+            // Keep running to catch anything fired after the cutoff.
+            for (int i = 0; i < 5 * 20; ++i)
+                step(true);
+        }
+    };
+
+    void onHalfCycle(unsigned long timestamp_us)
+    {
+        g_weld->regulator.onHalfCycle(timestamp_us);
+        if (g_weld->cutoff_us == 0 && g_weld->regulator.isWeldComplete())
+            g_weld->cutoff_us = timestamp_us;
+    }
+
+    const float TARGETS_J[] = {37.0, 151.3, 500.0, 1234.5};
+
+    void checkWeld(unsigned int delay_us, FiringMode mode)
+    {
+        for (float target_J : TARGETS_J)
+        {
+            Weld weld(delay_us, mode);
+            weld.run(target_J);
+
+            char message[96];
+            snprintf(message, sizeof(message), "target %.1fJ, delivered %.2fJ, last half-cycle %.2fJ",
+                     target_J, weld.delivered_J, weld.lastFired_J);
+            TEST_ASSERT_FLOAT_WITHIN_MESSAGE(0.5 * weld.lastFired_J, target_J, weld.delivered_J, message);
+
+            // Nothing may fire after the half-cycle in which the target was reached.
+            const std::vector<host::GateEdge> &log = host::gateLog();
+            TEST_ASSERT_TRUE(weld.cutoff_us != 0);
+            TEST_ASSERT_FALSE_MESSAGE(log.empty(), message);
+            TEST_ASSERT_FALSE_MESSAGE(log.back().on, "gate left on after the cutoff");
+            TEST_ASSERT_TRUE_MESSAGE(log.back().time_us <= weld.cutoff_us, "gate on after the cutoff");
+        }
+    }
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_phase_angle_energy_cutoff()
+{
+    checkWeld(3000, FiringMode::PHASE_ANGLE);
+}
+
+void test_phase_angle_energy_cutoff_no_delay()
+{
+    checkWeld(0, FiringMode::PHASE_ANGLE);
+}
+
+void test_burst_energy_cutoff()
+{
+    checkWeld(3000, FiringMode::BURST);
+}
+
+void test_burst_energy_cutoff_no_delay()
+{
+    checkWeld(0, FiringMode::BURST);
+}
+
+int main(int, char **)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_phase_angle_energy_cutoff);
+    RUN_TEST(test_phase_angle_energy_cutoff_no_delay);
+    RUN_TEST(test_burst_energy_cutoff);
+    RUN_TEST(test_burst_energy_cutoff_no_delay);
+    return UNITY_END();
+}
@@ -0,0 +1,368 @@
+// Host tests for the TRIAC firing modes, run against an event-driven model of
+// a clean 50Hz mains: zero-cross interrupts every 20ms and the esp_timer
+// callbacks they arm, in time order.
+//
+//   pio test -e native_test -f test_firing_model
+
+#include <Arduino.h>
+#include <unity.h>
+#include "TriacController.h"
+
+#include <random>
+
+namespace
+{
+    const unsigned long PERIOD_US = 20000;
+    const unsigned long HALF_PERIOD_US = PERIOD_US / 2;
+    const unsigned long CYCLES = 50 * 20; // 20 seconds of 50Hz mains
+
+    // Which side runs first when a timer is due at the same instant as the
+    // hardware zero-cross. On the target either can happen.
+    enum class Order
+    {
+        TIMERS_FIRST,
+        ZERO_CROSS_FIRST
+    };
+
+    struct FiringRun
+    {
+        unsigned long cycles;
+        unsigned long events;        // ZC interrupts plus timer callbacks
+        std::vector<long> firedAt_us; // Per true half-cycle: gate-on offset into it, or -1
+    };
+
+    struct Mains
+    {
+        TriacController triac;
+        unsigned long now_us = 1000000;
+        unsigned int delay_us;
+
+        explicit Mains(unsigned int measurementDelay_us) : delay_us(measurementDelay_us)
+        {
+            triac.begin(14, 48);
+            triac.setMeasurementDelay(delay_us);
+        }
+
+        // Runs whole mains cycles and records, for every true half-cycle, how far
+        // into it the gate came on. perCycle(c) runs just before the c-th zero-cross.
+        template <typename PerCycle>
+        FiringRun run(unsigned long cycles, Order order, PerCycle perCycle)
+        {
+            void (*isr)(void *) = host::zeroCrossIsr();
+            void *arg = host::zeroCrossArg();
+            esp_timer_handle_t tick = host::findTimer("zero_cross_timer");
+
+            FiringRun result = {};
+            unsigned long start_us = now_us;
+            host::resetCounters();
+            host::clearGateLog();
+            for (unsigned long c = 0; c < cycles; ++c)
+            {
+                perCycle(c);
+                now_us += PERIOD_US;
+                if (order == Order::TIMERS_FIRST)
+                {
+                    host::runTimersUntil(now_us);
+                    isr(arg);
+                }
+                else
+                {
+                    // The interrupt and its deferred tick run before any timer
+                    // that is due at the same instant.
+                    host::runTimersUntil(now_us - 1);
+                    host::setMicros(now_us);
+                    isr(arg);
+                    tick->armed = false;
+                    tick->callback(tick->arg);
+                    result.events++;
+                }
+                result.events++;
+            }
+            host::runTimersUntil(now_us);
+            result.cycles = cycles;
+            result.events += host::counters().timerCallbacks;
+
+            // The true zero-crosses lead the detector edges by the measurement delay.
+            for (unsigned long c = 0; c < cycles; ++c)
+            {
+                for (unsigned long h = 0; h < 2; ++h)
+                {
+                    unsigned long from_us = start_us - delay_us + c * PERIOD_US + h * HALF_PERIOD_US;
+                    result.firedAt_us.push_back(host::firstGateOn(from_us, from_us + HALF_PERIOD_US));
+                }
+            }
+            return result;
+        }
+
+        FiringRun run(unsigned long cycles, Order order = Order::TIMERS_FIRST)
+        {
+            return run(cycles, order, [](unsigned long) {});
+        }
+
+        // Lets the frequency monitor lock and any mode request latch.
+        void settle()
+        {
+            run(64);
+        }
+    };
+
+    unsigned long countConducted(const FiringRun &r)
+    {
+        unsigned long n = 0;
+        for (long firedAt : r.firedAt_us)
+            n += (firedAt >= 0);
+        return n;
+    }
+
+    // Counts the places where the load sees DC: a run of conducted half-cycles
+    // with an odd length, or a pair of halves in a run that fire at different
+    // points of their half-cycle. Runs cut off by the start or end of the
+    // recording are not counted.
+    unsigned long countUnbalancedCycles(const FiringRun &r)
+    {
+        const long tolerance_us = 50;
+        const std::vector<long> &f = r.firedAt_us;
+        unsigned long unbalanced = 0;
+        size_t i = 0;
+        while (i < f.size() && f[i] >= 0)
+            ++i;
+        while (i < f.size())
+        {
+            size_t begin = i;
+            while (i < f.size() && f[i] >= 0)
+                ++i;
+            if (i == f.size())
+                break;
+            if ((i - begin) % 2 != 0)
+                unbalanced++;
+            for (size_t k = begin; k + 1 < i; k += 2)
+            {
+                if (labs(f[k] - f[k + 1]) > tolerance_us)
+                    unbalanced++;
+            }
+            while (i < f.size() && f[i] < 0)
+                ++i;
+        }
+        return unbalanced;
+    }
+
+    // Load power as a percentage of full-wave power into a resistive load: a
+    // half-cycle fired at angle a carries 1 - a/pi + sin(2a)/(2pi) of its energy.
+    double deliveredPct(const FiringRun &r)
+    {
+        double sum = 0.0;
+        for (long firedAt : r.firedAt_us)
+        {
+            if (firedAt < 0)
+                continue;
+            double theta = M_PI * firedAt / HALF_PERIOD_US;
+            sum += 1.0 - theta / M_PI + sin(2.0 * theta) / (2.0 * M_PI);
+        }
+        return 100.0 * sum / r.firedAt_us.size();
+    }
+
+    const float POWERS[] = {5.0, 12.5, 30.0, 50.0, 77.0, 95.0};
+}
+
+void setUp()
+{
+    host::setMicros(0);
+}
+
+void tearDown() {}
+
+void test_phase_angle_fires_every_half_cycle()
+{
+    for (float power : POWERS)
+    {
+        Mains mains(3000);
+        mains.triac.setPower(power);
+        mains.settle();
+        FiringRun r = mains.run(CYCLES);
+        TEST_ASSERT_EQUAL_UINT32(2 * CYCLES, countConducted(r));
+    }
+}
+
+void test_burst_delivers_requested_fraction()
+{
+    for (float power : POWERS)
+    {
+        Mains mains(3000);
+        mains.triac.setFiringMode(FiringMode::BURST);
+        mains.triac.setPower(power);
+        mains.settle();
+        FiringRun r = mains.run(CYCLES);
+
+        char message[64];
+        snprintf(message, sizeof(message), "power %.1f%%", power);
+        double deliveredPct = 100.0 * countConducted(r) / (2.0 * CYCLES);
+        TEST_ASSERT_FLOAT_WITHIN_MESSAGE(100.0 / CYCLES + 0.01, power, deliveredPct, message);
+        TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, countUnbalancedCycles(r), message);
+    }
+}
+
+// Toggles the mode at random cycles while firing, so switches land both right
+// after burst on-cycles and after off-cycles. No cycle may ever be split
+// between the two modes or fired differently in its two halves.
+void checkSwitching(unsigned int delay_us, Order order)
+{
+    Mains mains(delay_us);
+    mains.triac.setPower(60.0);
+    mains.settle();
+
+    std::mt19937 random(1234);
+    bool burst = false;
+    FiringRun r = mains.run(CYCLES, order, [&](unsigned long)
+                            {
+        if (random() % 3 == 0)
+        {
+            burst = !burst;
+            mains.triac.setFiringMode(burst ? FiringMode::BURST : FiringMode::PHASE_ANGLE);
+        } });
+    TEST_ASSERT_EQUAL_UINT32(0, countUnbalancedCycles(r));
+}
+
+void test_switching_timers_first()
+{
+    checkSwitching(3000, Order::TIMERS_FIRST);
+}
+
+void test_switching_zero_cross_first()
+{
+    checkSwitching(3000, Order::ZERO_CROSS_FIRST);
+}
+
+// With no detector delay, the falling-edge timer of one cycle and the hardware
+// zero-cross of the next land on the same instant.
+void test_switching_no_delay_timers_first()
+{
+    checkSwitching(0, Order::TIMERS_FIRST);
+}
+
+void test_switching_no_delay_zero_cross_first()
+{
+    checkSwitching(0, Order::ZERO_CROSS_FIRST);
+}
+
+// The same power level must give the same load power in both modes, so a mode
+// switch under the regulator does not step the load.
+void checkSwitchPower(unsigned int delay_us, float power)
+{
+    const unsigned long cycles = 200;
+    for (FiringMode from : {FiringMode::PHASE_ANGLE, FiringMode::BURST})
+    {
+        FiringMode to = (from == FiringMode::BURST) ? FiringMode::PHASE_ANGLE : FiringMode::BURST;
+        Mains mains(delay_us);
+        mains.triac.setFiringMode(from);
+        mains.triac.setPower(power);
+        mains.settle();
+        double before = deliveredPct(mains.run(cycles));
+        mains.triac.setFiringMode(to);
+        double after = deliveredPct(mains.run(cycles));
+
+        char message[80];
+        snprintf(message, sizeof(message), "delay %uus, power %.1f%%: %.2f%% before, %.2f%% after",
+                 delay_us, power, before, after);
+        TEST_ASSERT_FLOAT_WITHIN_MESSAGE(100.0 / cycles + 0.5, power, before, message);
+        TEST_ASSERT_FLOAT_WITHIN_MESSAGE(100.0 / cycles + 0.5, power, after, message);
+    }
+}
+
+void test_switching_keeps_load_power()
+{
+    // Phase angle cannot fire the rising half earlier than the detector delay
+    // after its zero-cross, so with 3ms of delay the top of the range is only
+    // reachable without it.
+    for (float power : {5.0f, 25.0f, 50.0f, 75.0f})
+        checkSwitchPower(3000, power);
+    for (float power : {5.0f, 25.0f, 50.0f, 75.0f, 95.0f})
+        checkSwitchPower(0, power);
+}
+
+void onHalfCycle(unsigned long) {}
+
+// Burst mode holds the gate through runs of on-cycles, so it must need less
+// interrupt and timer work than phase angle at every power level, with or
+// without a half-cycle callback (which forces a timer every half-cycle).
+void checkBurstEvents(bool withCallback)
+{
+    const float powers[] = {5.0, 12.5, 30.0, 50.0, 77.0, 95.0, 100.0};
+    for (float power : powers)
+    {
+        unsigned long events[2];
+        for (FiringMode mode : {FiringMode::PHASE_ANGLE, FiringMode::BURST})
+        {
+            Mains mains(3000);
+            if (withCallback)
+                mains.triac.attachHalfCycleCallback(onHalfCycle);
+            mains.triac.setFiringMode(mode);
+            mains.triac.setPower(power);
+            mains.settle();
+            events[(int)mode] = mains.run(CYCLES).events;
+        }
+
+        char message[64];
+        snprintf(message, sizeof(message), "power %.1f%%: %lu burst vs %lu phase events",
+                 power, events[(int)FiringMode::BURST], events[(int)FiringMode::PHASE_ANGLE]);
+        TEST_ASSERT_TRUE_MESSAGE(events[(int)FiringMode::BURST] < events[(int)FiringMode::PHASE_ANGLE], message);
+    }
+}
+
+void test_burst_needs_fewer_events()
+{
+    checkBurstEvents(false);
+}
+
+void test_burst_needs_fewer_events_with_callback()
+{
+    checkBurstEvents(true);
+}
+
+// A lost detector signal or mains dropout in the middle of a burst on-run must
+// not leave the gate held: the cycle in progress may finish, nothing after it.
+void test_burst_gate_released_when_edges_stop()
+{
+    const float powers[] = {60.0, 100.0};
+    for (unsigned int delay_us : {3000u, 0u})
+    {
+        for (float power : powers)
+        {
+            Mains mains(delay_us);
+            mains.triac.setFiringMode(FiringMode::BURST);
+            mains.triac.setPower(power);
+            mains.settle();
+            mains.run(10);
+
+            // The cycle decided at the last edge starts at the falling zero-cross
+            // after it; the edge that would follow never comes.
+            unsigned long cycleStart_us = mains.now_us - delay_us + HALF_PERIOD_US;
+            host::clearGateLog();
+            host::runTimersUntil(mains.now_us + 5000000);
+
+            char message[64];
+            snprintf(message, sizeof(message), "delay %uus, power %.1f%%", delay_us, power);
+            const std::vector<host::GateEdge> &log = host::gateLog();
+            TEST_ASSERT_FALSE_MESSAGE(!log.empty() && log.back().on, message);
+            long firstHalf = host::firstGateOn(cycleStart_us, cycleStart_us + HALF_PERIOD_US);
+            long secondHalf = host::firstGateOn(cycleStart_us + HALF_PERIOD_US, cycleStart_us + PERIOD_US);
+            TEST_ASSERT_EQUAL_MESSAGE(firstHalf >= 0, secondHalf >= 0, message);
+            TEST_ASSERT_EQUAL_MESSAGE(-1, host::firstGateOn(cycleStart_us + PERIOD_US, mains.now_us + 5000000), message);
+        }
+    }
+}
+
+int main(int, char **)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_phase_angle_fires_every_half_cycle);
+    RUN_TEST(test_burst_delivers_requested_fraction);
+    RUN_TEST(test_switching_timers_first);
+    RUN_TEST(test_switching_zero_cross_first);
+    RUN_TEST(test_switching_no_delay_timers_first);
+    RUN_TEST(test_switching_no_delay_zero_cross_first);
+    RUN_TEST(test_switching_keeps_load_power);
+    RUN_TEST(test_burst_needs_fewer_events);
+    RUN_TEST(test_burst_needs_fewer_events_with_callback);
+    RUN_TEST(test_burst_gate_released_when_edges_stop);
+    return UNITY_END();
+}
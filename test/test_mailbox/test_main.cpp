@@ -0,0 +1,132 @@
+// Host tests for the cross-core Mailbox.
+//
+//   pio test -e native_test -f test_mailbox
+
+#include <unity.h>
+#include "Mailbox.h"
+
+#include <atomic>
+#include <thread>
+
+namespace
+{
+    // Every payload word is derived from the sequence number, so a torn read
+    // (words from two different posts) shows up as a mismatch.
+    struct Payload
+    {
+        uint32_t sequence;
+        uint32_t words[7];
+    };
+
+    Payload makePayload(uint32_t sequence)
+    {
+        Payload p;
+        p.sequence = sequence;
+        for (uint32_t k = 0; k < 7; ++k)
+            p.words[k] = sequence * 2654435761u + k;
+        return p;
+    }
+
+    bool isConsistent(const Payload &p)
+    {
+        for (uint32_t k = 0; k < 7; ++k)
+        {
+            if (p.words[k] != p.sequence * 2654435761u + k)
+                return false;
+        }
+        return true;
+    }
+
+    const uint32_t HANDOFF_POSTS = 2000000;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_fetch_without_post_leaves_value()
+{
+    Mailbox<int> mailbox;
+    int value = 42;
+    TEST_ASSERT_FALSE(mailbox.fetch(value));
+    TEST_ASSERT_EQUAL(42, value);
+}
+
+void test_fetch_returns_each_value_once()
+{
+    Mailbox<int> mailbox;
+    int value = 0;
+    mailbox.post(7);
+    TEST_ASSERT_TRUE(mailbox.fetch(value));
+    TEST_ASSERT_EQUAL(7, value);
+    TEST_ASSERT_FALSE(mailbox.fetch(value));
+    TEST_ASSERT_EQUAL(7, value);
+}
+
+void test_latest_value_wins()
+{
+    Mailbox<int> mailbox;
+    int value = 0;
+    for (int i = 1; i <= 5; ++i)
+        mailbox.post(i);
+    TEST_ASSERT_TRUE(mailbox.fetch(value));
+    TEST_ASSERT_EQUAL(5, value);
+
+    // Interleaved posts and fetches must never bring back an older slot.
+    for (int i = 6; i <= 100; ++i)
+    {
+        mailbox.post(i);
+        if (i % 3 == 0)
+        {
+            TEST_ASSERT_TRUE(mailbox.fetch(value));
+            TEST_ASSERT_EQUAL(i, value);
+        }
+    }
+}
+
+// One thread stands in for the firing core and one for the control core.
+void test_threaded_handoff_is_never_torn_or_reordered()
+{
+    Mailbox<Payload> mailbox;
+    std::atomic<bool> done{false};
+    unsigned long torn = 0, backwards = 0, reads = 0;
+    uint32_t last = 0;
+
+    std::thread consumer([&]
+                         {
+        Payload p = {};
+        for (;;)
+        {
+            bool finished = done.load(std::memory_order_acquire);
+            if (mailbox.fetch(p))
+            {
+                reads++;
+                if (!isConsistent(p))
+                    torn++;
+                if (p.sequence < last)
+                    backwards++;
+                last = p.sequence;
+            }
+            else if (finished)
+                break;
+        } });
+
+    for (uint32_t sequence = 1; sequence <= HANDOFF_POSTS; ++sequence)
+        mailbox.post(makePayload(sequence));
+    done.store(true, std::memory_order_release);
+    consumer.join();
+
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, torn, "torn reads");
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, backwards, "out-of-order reads");
+    TEST_ASSERT_TRUE(reads > 0);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(HANDOFF_POSTS, last, "last post not delivered");
+}
+
+int main(int, char **)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_fetch_without_post_leaves_value);
+    RUN_TEST(test_fetch_returns_each_value_once);
+    RUN_TEST(test_latest_value_wins);
+    RUN_TEST(test_threaded_handoff_is_never_torn_or_reordered);
+    return UNITY_END();
+}